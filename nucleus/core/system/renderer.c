@@ -140,6 +140,27 @@ nu_result_t nu_renderer_staticmesh_set_transform(nu_renderer_staticmesh_handle_t
 {
     return _system.interface.staticmesh_set_transform(handle, transform);
 }
+nu_result_t nu_renderer_staticmesh_query_ray(const nu_vec3_t origin, const nu_vec3_t direction, float max_distance, bool *hit, nu_renderer_ray_hit_t *result)
+{
+    return _system.interface.staticmesh_query_ray(origin, direction, max_distance, hit, result);
+}
+nu_result_t nu_renderer_staticmesh_query_aabb(const nu_vec3_t min, const nu_vec3_t max, nu_renderer_staticmesh_handle_t *handles, uint32_t capacity, uint32_t *count)
+{
+    return _system.interface.staticmesh_query_aabb(min, max, handles, capacity, count);
+}
+
+nu_result_t nu_renderer_instancedmesh_create(nu_renderer_instancedmesh_handle_t *handle, const nu_renderer_instancedmesh_create_info_t *info)
+{
+    return _system.interface.instancedmesh_create(handle, info);
+}
+nu_result_t nu_renderer_instancedmesh_destroy(nu_renderer_instancedmesh_handle_t handle)
+{
+    return _system.interface.instancedmesh_destroy(handle);
+}
+nu_result_t nu_renderer_instancedmesh_set_transforms(nu_renderer_instancedmesh_handle_t handle, const nu_mat4_t *transforms, uint32_t count)
+{
+    return _system.interface.instancedmesh_set_transforms(handle, transforms, count);
+}
 
 nu_result_t nu_renderer_label_create(nu_renderer_label_handle_t *handle, const nu_renderer_label_create_info_t *info)
 {
@@ -43,6 +43,12 @@ NU_API nu_result_t nu_renderer_camera_set_center(nu_renderer_camera_handle_t han
 NU_API nu_result_t nu_renderer_staticmesh_create(nu_renderer_staticmesh_handle_t *handle, const nu_renderer_staticmesh_create_info_t *info);
 NU_API nu_result_t nu_renderer_staticmesh_destroy(nu_renderer_staticmesh_handle_t handle);
 NU_API nu_result_t nu_renderer_staticmesh_set_transform(nu_renderer_staticmesh_handle_t handle, const nu_mat4_t transform);
+NU_API nu_result_t nu_renderer_staticmesh_query_ray(const nu_vec3_t origin, const nu_vec3_t direction, float max_distance, bool *hit, nu_renderer_ray_hit_t *result);
+NU_API nu_result_t nu_renderer_staticmesh_query_aabb(const nu_vec3_t min, const nu_vec3_t max, nu_renderer_staticmesh_handle_t *handles, uint32_t capacity, uint32_t *count);
+
+NU_API nu_result_t nu_renderer_instancedmesh_create(nu_renderer_instancedmesh_handle_t *handle, const nu_renderer_instancedmesh_create_info_t *info);
+NU_API nu_result_t nu_renderer_instancedmesh_destroy(nu_renderer_instancedmesh_handle_t handle);
+NU_API nu_result_t nu_renderer_instancedmesh_set_transforms(nu_renderer_instancedmesh_handle_t handle, const nu_mat4_t *transforms, uint32_t count);
 
 NU_API nu_result_t nu_renderer_label_create(nu_renderer_label_handle_t *handle, const nu_renderer_label_create_info_t *info);
 NU_API nu_result_t nu_renderer_label_destroy(nu_renderer_label_handle_t handle);
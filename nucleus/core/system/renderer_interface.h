@@ -12,6 +12,7 @@ NU_DECLARE_HANDLE(nu_renderer_font_handle_t);
 NU_DECLARE_HANDLE(nu_renderer_texture_handle_t);
 NU_DECLARE_HANDLE(nu_renderer_camera_handle_t);
 NU_DECLARE_HANDLE(nu_renderer_staticmesh_handle_t);
+NU_DECLARE_HANDLE(nu_renderer_instancedmesh_handle_t);
 NU_DECLARE_HANDLE(nu_renderer_label_handle_t);
 NU_DECLARE_HANDLE(nu_renderer_rectangle_handle_t);
 
@@ -25,13 +26,21 @@ typedef struct {
     uint32_t *position_indices;
     uint32_t *uv_indices;
     uint32_t *color_indices;
+    /* simplified levels generated at creation (up to 4) */
+    uint32_t lod_count;
 } nu_renderer_mesh_create_info_t;
 
+typedef enum {
+    NU_RENDERER_TEXTURE_FILTER_NEAREST  = 0,
+    NU_RENDERER_TEXTURE_FILTER_BILINEAR = 1
+} nu_renderer_texture_filter_t;
+
 typedef struct {
     uint32_t width;
     uint32_t height;
     uint32_t channel;
     unsigned char *data;
+    nu_renderer_texture_filter_t filter;
 } nu_renderer_texture_create_info_t;
 
 typedef struct {
@@ -50,8 +59,23 @@ typedef struct {
     nu_renderer_mesh_handle_t mesh;
     nu_renderer_texture_handle_t texture;
     nu_mat4_t transform;
+    bool occluder;
 } nu_renderer_staticmesh_create_info_t;
 
+typedef struct {
+    nu_renderer_mesh_handle_t mesh;
+    nu_renderer_texture_handle_t texture;
+    uint32_t instance_count;
+    const nu_mat4_t *transforms;
+    bool occluder;
+} nu_renderer_instancedmesh_create_info_t;
+
+typedef struct {
+    nu_renderer_staticmesh_handle_t staticmesh;
+    float distance;
+    nu_vec3_t position;
+} nu_renderer_ray_hit_t;
+
 typedef struct {
     uint32_t x;
     uint32_t y;
@@ -89,6 +113,12 @@ typedef struct {
     nu_result_t (*staticmesh_create)(nu_renderer_staticmesh_handle_t*, const nu_renderer_staticmesh_create_info_t*);
     nu_result_t (*staticmesh_destroy)(nu_renderer_staticmesh_handle_t);
     nu_result_t (*staticmesh_set_transform)(nu_renderer_staticmesh_handle_t, const nu_mat4_t);
+    nu_result_t (*staticmesh_query_ray)(const nu_vec3_t, const nu_vec3_t, float, bool*, nu_renderer_ray_hit_t*);
+    nu_result_t (*staticmesh_query_aabb)(const nu_vec3_t, const nu_vec3_t, nu_renderer_staticmesh_handle_t*, uint32_t, uint32_t*);
+
+    nu_result_t (*instancedmesh_create)(nu_renderer_instancedmesh_handle_t*, const nu_renderer_instancedmesh_create_info_t*);
+    nu_result_t (*instancedmesh_destroy)(nu_renderer_instancedmesh_handle_t);
+    nu_result_t (*instancedmesh_set_transforms)(nu_renderer_instancedmesh_handle_t, const nu_mat4_t*, uint32_t);
 
     nu_result_t (*label_create)(nu_renderer_label_handle_t*, const nu_renderer_label_create_info_t*);
     nu_result_t (*label_destroy)(nu_renderer_label_handle_t);
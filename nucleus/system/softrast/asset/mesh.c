@@ -1,6 +1,15 @@
 #include "mesh.h"
 
+#include "simplify.h"
+
+#include <math.h>
+
 #define MAX_MESH_COUNT 32
+/* meshes are not simplified below this number of triangles */
+#define MIN_LOD_TRIANGLE_COUNT 16
+/* surface error of the first level relative to the bounding box diagonal,
+ * each level is displayed at half the size and doubles it */
+#define LOD_ERROR 0.01f
 
 typedef struct {
     nusr_mesh_t **meshes;
@@ -9,56 +18,134 @@ typedef struct {
 
 static nusr_asset_mesh_data_t _data;
 
+typedef struct {
+    nu_vec3_t position;
+    nu_vec2_t uv;
+    nu_vec3_t color;
+} nusr_mesh_vertex_t;
+
+static void get_vertex(const nu_renderer_mesh_create_info_t *info, uint32_t i, nusr_mesh_vertex_t *vertex)
+{
+    /* zero padding and missing attributes so vertices can be compared */
+    memset(vertex, 0, sizeof(nusr_mesh_vertex_t));
+    if (info->use_indices) {
+        nu_vec3_copy(info->positions[info->position_indices[i]], vertex->position);
+        nu_vec2_copy(info->uvs[info->uv_indices[i]], vertex->uv);
+        if (info->use_colors) nu_vec3_copy(info->colors[info->color_indices[i]], vertex->color);
+    } else {
+        nu_vec3_copy(info->positions[i], vertex->position);
+        nu_vec2_copy(info->uvs[i], vertex->uv);
+        if (info->use_colors) nu_vec3_copy(info->colors[i], vertex->color);
+    }
+}
+static uint32_t hash_vertex(const nusr_mesh_vertex_t *vertex)
+{
+    /* FNV-1a */
+    const unsigned char *bytes = (const unsigned char*)vertex;
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < sizeof(nusr_mesh_vertex_t); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+static void free_mesh(nusr_mesh_t *mesh)
+{
+    nu_free(mesh->indices);
+    nu_free(mesh->positions);
+    nu_free(mesh->uvs);
+    if (mesh->colors) {
+        nu_free(mesh->colors);
+    }
+    for (uint32_t i = 0; i < mesh->lod_count; i++) {
+        free_mesh(&mesh->lods[i]);
+    }
+    if (mesh->lods) {
+        nu_free(mesh->lods);
+    }
+}
+static void generate_lods(nusr_mesh_t *mesh, uint32_t lod_count)
+{
+    /* each level targets a quarter of the previous triangles, generation
+     * stops when seams, borders or the error bound keep more than half */
+    const nu_vec3_t diagonal = {mesh->xmax - mesh->xmin, mesh->ymax - mesh->ymin, mesh->zmax - mesh->zmin};
+    float max_error = LOD_ERROR * sqrtf(nu_vec3_dot(diagonal, diagonal));
+    mesh->lods = (nusr_mesh_t*)nu_malloc(sizeof(nusr_mesh_t) * lod_count);
+    const nusr_mesh_t *previous = mesh;
+    for (uint32_t i = 0; i < lod_count; i++) {
+        uint32_t triangle_count = previous->index_count / 3 / 4;
+        if (triangle_count < MIN_LOD_TRIANGLE_COUNT) break;
+
+        /* levels are simplified from the previous one, their errors add
+         * up to less than twice the bound of the level */
+        nusr_mesh_t *lod = &mesh->lods[i];
+        if (nusr_mesh_simplify(previous, triangle_count * 3, max_error, lod) != NU_SUCCESS) break;
+        if (lod->index_count > previous->index_count / 2) {
+            free_mesh(lod);
+            break;
+        }
+        mesh->lod_count++;
+        previous = lod;
+        max_error *= 2.0f;
+    }
+}
 static nu_result_t create_mesh(uint32_t *id, const nu_renderer_mesh_create_info_t *info)
 {
     /* error check */
     if (_data.next_id >= MAX_MESH_COUNT) return NU_FAILURE;
 
     /* create mesh */
-    _data.meshes[_data.next_id] = (nusr_mesh_t*)nu_malloc(sizeof(nusr_mesh_t));
-    _data.meshes[_data.next_id]->vertex_count = info->vertice_count;
-
-    /* allocate memory */
-    _data.meshes[_data.next_id]->positions = (nu_vec3_t*)nu_malloc(sizeof(nu_vec3_t) * info->vertice_count);
-    _data.meshes[_data.next_id]->uvs = (nu_vec2_t*)nu_malloc(sizeof(nu_vec2_t) * info->vertice_count);
-    if (info->use_colors) {
-        _data.meshes[_data.next_id]->colors = (nu_vec3_t*)nu_malloc(sizeof(nu_vec3_t) * info->vertice_count);
-    } else {
-        _data.meshes[_data.next_id]->colors = NULL;
-    }
-    
-    /* copy data */
-    if (info->use_indices) {
-        for (uint32_t i = 0; i < info->vertice_count; i++) {
-            uint32_t position_indice = info->position_indices[i];
-            uint32_t uv_indice = info->uv_indices[i];
-            nu_vec3_copy(info->positions[position_indice], _data.meshes[_data.next_id]->positions[i]);
-            nu_vec2_copy(info->uvs[uv_indice], _data.meshes[_data.next_id]->uvs[i]);
-            
-            if (info->use_colors) {
-                uint32_t color_indice = info->color_indices[i];
-                nu_vec3_copy(info->colors[color_indice], _data.meshes[_data.next_id]->colors[i]);
-            }
+    nusr_mesh_t *mesh = (nusr_mesh_t*)nu_malloc(sizeof(nusr_mesh_t));
+    _data.meshes[_data.next_id] = mesh;
+    mesh->index_count = info->vertice_count;
+    mesh->indices = (uint32_t*)nu_malloc(sizeof(uint32_t) * info->vertice_count);
+
+    /* deduplicate vertices with an open addressing table of unique vertices */
+    uint32_t table_size = 1;
+    while (table_size < info->vertice_count * 2) table_size <<= 1;
+    uint32_t *table = (uint32_t*)nu_malloc(sizeof(uint32_t) * table_size);
+    memset(table, 0xFF, sizeof(uint32_t) * table_size);
+    nusr_mesh_vertex_t *vertices = (nusr_mesh_vertex_t*)nu_malloc(sizeof(nusr_mesh_vertex_t) * info->vertice_count);
+    uint32_t vertex_count = 0;
+    for (uint32_t i = 0; i < info->vertice_count; i++) {
+        nusr_mesh_vertex_t vertex;
+        get_vertex(info, i, &vertex);
+        uint32_t slot = hash_vertex(&vertex) & (table_size - 1);
+        while (table[slot] != UINT32_MAX && memcmp(&vertices[table[slot]], &vertex, sizeof(nusr_mesh_vertex_t))) {
+            slot = (slot + 1) & (table_size - 1);
         }
-    } else {
-        memcpy(_data.meshes[_data.next_id]->positions, info->positions, sizeof(nu_vec3_t) * info->vertice_count);
-        memcpy(_data.meshes[_data.next_id]->uvs, info->uvs, sizeof(nu_vec2_t) * info->vertice_count);
-        
-        if (info->use_colors) {
-            memcpy(_data.meshes[_data.next_id]->colors, info->colors, sizeof(nu_vec3_t) * info->vertice_count);
-        } else {
-            _data.meshes[_data.next_id]->colors = NULL;
+        if (table[slot] == UINT32_MAX) {
+            table[slot] = vertex_count;
+            vertices[vertex_count++] = vertex;
         }
+        mesh->indices[i] = table[slot];
+    }
+    nu_free(table);
+
+    /* copy unique vertices */
+    mesh->vertex_count = vertex_count;
+    mesh->positions = (nu_vec3_t*)nu_malloc(sizeof(nu_vec3_t) * vertex_count);
+    mesh->uvs = (nu_vec2_t*)nu_malloc(sizeof(nu_vec2_t) * vertex_count);
+    mesh->colors = info->use_colors ? (nu_vec3_t*)nu_malloc(sizeof(nu_vec3_t) * vertex_count) : NULL;
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        nu_vec3_copy(vertices[i].position, mesh->positions[i]);
+        nu_vec2_copy(vertices[i].uv, mesh->uvs[i]);
+        if (mesh->colors) nu_vec3_copy(vertices[i].color, mesh->colors[i]);
     }
+    nu_free(vertices);
 
     /* compute min/max positions */
     float xmin, xmax, ymin, ymax, zmin, zmax;
     xmin = xmax = ymin = ymax = zmin = zmax = 0.0f;
-    for (uint32_t i = 0; i < _data.meshes[_data.next_id]->vertex_count; i++) {
+    if (mesh->vertex_count > 0) {
+        xmin = xmax = mesh->positions[0][0];
+        ymin = ymax = mesh->positions[0][1];
+        zmin = zmax = mesh->positions[0][2];
+    }
+    for (uint32_t i = 0; i < mesh->vertex_count; i++) {
         float x, y, z;
-        x = _data.meshes[_data.next_id]->positions[i][0];
-        y = _data.meshes[_data.next_id]->positions[i][1];
-        z = _data.meshes[_data.next_id]->positions[i][2];
+        x = mesh->positions[i][0];
+        y = mesh->positions[i][1];
+        z = mesh->positions[i][2];
         xmin = x < xmin ? x : xmin;
         xmax = x > xmax ? x : xmax;
         ymin = y < ymin ? y : ymin;
@@ -66,13 +153,19 @@ static nu_result_t create_mesh(uint32_t *id, const nu_renderer_mesh_create_info_
         zmin = z < zmin ? z : zmin;
         zmax = z > zmax ? z : zmax;
     }
-    _data.meshes[_data.next_id]->xmax = xmax;
-    _data.meshes[_data.next_id]->xmin = xmin;
-    _data.meshes[_data.next_id]->ymax = ymax;
-    _data.meshes[_data.next_id]->ymin = ymin;
-    _data.meshes[_data.next_id]->zmax = zmax;
-    _data.meshes[_data.next_id]->zmin = zmin;
-
+    mesh->xmax = xmax;
+    mesh->xmin = xmin;
+    mesh->ymax = ymax;
+    mesh->ymin = ymin;
+    mesh->zmax = zmax;
+    mesh->zmin = zmin;
+
+    /* levels of detail */
+    mesh->lods = NULL;
+    mesh->lod_count = 0;
+    if (info->lod_count) {
+        generate_lods(mesh, NU_MIN(info->lod_count, NUSR_MESH_MAX_LOD_COUNT));
+    }
 
     /* save id */
     *id = _data.next_id++;
@@ -84,12 +177,7 @@ static nu_result_t destroy_mesh(uint32_t id)
     if (_data.next_id >= MAX_MESH_COUNT) return NU_FAILURE;
     if (!_data.meshes[id]) return NU_FAILURE;
 
-    nu_free(_data.meshes[id]->positions);
-    nu_free(_data.meshes[id]->uvs);
-    if (_data.meshes[id]->colors) {
-        nu_free(_data.meshes[id]->colors);
-    }
-
+    free_mesh(_data.meshes[id]);
     nu_free(_data.meshes[id]);
     _data.meshes[id] = NULL;
 
@@ -3,17 +3,27 @@
 
 #include "../module/interface.h"
 
-typedef struct {
+#define NUSR_MESH_MAX_LOD_COUNT 4
+
+typedef struct nusr_mesh {
+    /* unique vertices */
     uint32_t vertex_count;
     nu_vec3_t *positions;
     nu_vec2_t *uvs;
     nu_vec3_t *colors;
+    /* triangle list */
+    uint32_t index_count;
+    uint32_t *indices;
     float xmax;
     float xmin;
     float ymax;
     float ymin;
     float zmax;
     float zmin;
+    /* simplified levels, each one has about a quarter of the triangles
+     * of the previous one */
+    struct nusr_mesh *lods;
+    uint32_t lod_count;
 } nusr_mesh_t;
 
 nu_result_t nusr_mesh_initialize(void);
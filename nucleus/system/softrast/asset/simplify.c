@@ -0,0 +1,492 @@
+#include "simplify.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+/* collapses of a pass touch disjoint triangles, the vertex adjacency is
+ * rebuilt between passes */
+#define MAX_PASS_COUNT 32
+
+typedef struct {
+    /* upper triangle of the symmetric 4x4 matrix */
+    float m[10];
+    /* sum of the plane weights */
+    float area;
+} nusr_quadric_t;
+
+typedef struct {
+    float cost;
+    uint32_t group;
+    uint32_t target;
+} nusr_collapse_t;
+
+typedef struct {
+    /* position groups, a is the vertex of the lowest group */
+    uint64_t key;
+    uint32_t a;
+    uint32_t b;
+} nusr_edge_t;
+
+typedef struct {
+    const nusr_mesh_t *mesh;
+    uint32_t *indices;
+    uint32_t index_count;
+    /* vertices split by uv or color seams share a position group named
+     * after its first vertex, siblings link the vertices of a group */
+    uint32_t *groups;
+    uint32_t *siblings;
+    /* per group, seam and border groups only move along their two seam
+     * or border edges */
+    uint32_t *sizes;
+    bool *locked;
+    uint32_t *special_counts;
+    uint32_t *specials;
+    nusr_quadric_t *quadrics;
+    nusr_edge_t *edges;
+    /* cheapest collapse of each group */
+    float *costs;
+    uint32_t *targets;
+    nusr_collapse_t *collapses;
+    /* triangles around each vertex */
+    uint32_t *offsets;
+    uint32_t *adjacency;
+    bool *touched;
+} nusr_simplifier_t;
+
+static void quadric_from_triangle(const nu_vec3_t p0, const nu_vec3_t p1, const nu_vec3_t p2, nusr_quadric_t *q)
+{
+    /* plane quadric weighted by the triangle area */
+    memset(q, 0, sizeof(nusr_quadric_t));
+    nu_vec3_t e1, e2, n;
+    nu_vec3_sub(p1, p0, e1);
+    nu_vec3_sub(p2, p0, e2);
+    nu_vec3_cross(e1, e2, n);
+    const float length = sqrtf(nu_vec3_dot(n, n));
+    if (length == 0.0f) return;
+
+    const float area = 0.5f * length;
+    const float a = n[0] / length;
+    const float b = n[1] / length;
+    const float c = n[2] / length;
+    const float d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+    q->m[0] = a * a * area;
+    q->m[1] = a * b * area;
+    q->m[2] = a * c * area;
+    q->m[3] = a * d * area;
+    q->m[4] = b * b * area;
+    q->m[5] = b * c * area;
+    q->m[6] = b * d * area;
+    q->m[7] = c * c * area;
+    q->m[8] = c * d * area;
+    q->m[9] = d * d * area;
+    q->area = area;
+}
+static void quadric_add(nusr_quadric_t *q, const nusr_quadric_t *other)
+{
+    for (uint32_t i = 0; i < 10; i++) {
+        q->m[i] += other->m[i];
+    }
+    q->area += other->area;
+}
+static float quadric_error(const nusr_quadric_t *q0, const nusr_quadric_t *q1, const nu_vec3_t p)
+{
+    /* mean squared distance of the position to the planes of both
+     * quadrics */
+    const float area = q0->area + q1->area;
+    if (area == 0.0f) return 0.0f;
+    float m[10];
+    for (uint32_t i = 0; i < 10; i++) {
+        m[i] = q0->m[i] + q1->m[i];
+    }
+    const float x = p[0];
+    const float y = p[1];
+    const float z = p[2];
+    const float error = m[0] * x * x + 2.0f * m[1] * x * y + 2.0f * m[2] * x * z + 2.0f * m[3] * x
+        + m[4] * y * y + 2.0f * m[5] * y * z + 2.0f * m[6] * y
+        + m[7] * z * z + 2.0f * m[8] * z
+        + m[9];
+    return fabsf(error) / area;
+}
+static void triangle_normal(const nu_vec3_t p0, const nu_vec3_t p1, const nu_vec3_t p2, nu_vec3_t n)
+{
+    nu_vec3_t e1, e2;
+    nu_vec3_sub(p1, p0, e1);
+    nu_vec3_sub(p2, p0, e2);
+    nu_vec3_cross(e1, e2, n);
+}
+
+static int compare_edges(const void *a, const void *b)
+{
+    uint64_t ka = ((const nusr_edge_t*)a)->key;
+    uint64_t kb = ((const nusr_edge_t*)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+static int compare_collapses(const void *a, const void *b)
+{
+    float ca = ((const nusr_collapse_t*)a)->cost;
+    float cb = ((const nusr_collapse_t*)b)->cost;
+    return (ca > cb) - (ca < cb);
+}
+
+static void weld_positions(nusr_simplifier_t *self)
+{
+    /* open addressing table of unique positions */
+    const nusr_mesh_t *mesh = self->mesh;
+    uint32_t table_size = 1;
+    while (table_size < mesh->vertex_count * 2) table_size <<= 1;
+    uint32_t *table = (uint32_t*)nu_malloc(sizeof(uint32_t) * table_size);
+    memset(table, 0xFF, sizeof(uint32_t) * table_size);
+    for (uint32_t v = 0; v < mesh->vertex_count; v++) {
+        /* FNV-1a */
+        const unsigned char *bytes = (const unsigned char*)mesh->positions[v];
+        uint32_t hash = 2166136261u;
+        for (uint32_t i = 0; i < sizeof(nu_vec3_t); i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        uint32_t slot = hash & (table_size - 1);
+        while (table[slot] != UINT32_MAX && memcmp(mesh->positions[table[slot]], mesh->positions[v], sizeof(nu_vec3_t))) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        /* siblings form a circular list */
+        if (table[slot] == UINT32_MAX) {
+            table[slot] = v;
+            self->siblings[v] = v;
+        } else {
+            self->siblings[v] = self->siblings[table[slot]];
+            self->siblings[table[slot]] = v;
+        }
+        self->groups[v] = table[slot];
+    }
+    nu_free(table);
+}
+static void add_special(nusr_simplifier_t *self, uint32_t group, uint32_t neighbour)
+{
+    if (self->special_counts[group] < 2) {
+        self->specials[group * 2 + self->special_counts[group]] = neighbour;
+    }
+    self->special_counts[group]++;
+}
+static void classify_groups(nusr_simplifier_t *self)
+{
+    const uint32_t vertex_count = self->mesh->vertex_count;
+
+    /* referenced vertices of each group */
+    memset(self->sizes, 0, sizeof(uint32_t) * vertex_count);
+    memset(self->touched, 0, sizeof(bool) * vertex_count);
+    for (uint32_t i = 0; i < self->index_count; i++) {
+        const uint32_t v = self->indices[i];
+        if (self->touched[v]) continue;
+        self->touched[v] = true;
+        self->sizes[self->groups[v]]++;
+    }
+
+    /* edges between groups are shared by two triangles on closed surfaces,
+     * they are border edges with one triangle and seam edges when both
+     * triangles use different vertices */
+    uint32_t edge_count = 0;
+    for (uint32_t t = 0; t < self->index_count; t += 3) {
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t a = self->indices[t + k];
+            uint32_t b = self->indices[t + (k + 1) % 3];
+            if (self->groups[a] > self->groups[b]) {
+                uint32_t tmp = a;
+                a = b;
+                b = tmp;
+            }
+            nusr_edge_t *edge = &self->edges[edge_count++];
+            edge->key = ((uint64_t)self->groups[a] << 32) | self->groups[b];
+            edge->a = a;
+            edge->b = b;
+        }
+    }
+    qsort(self->edges, edge_count, sizeof(nusr_edge_t), compare_edges);
+
+    memset(self->locked, 0, sizeof(bool) * vertex_count);
+    memset(self->special_counts, 0, sizeof(uint32_t) * vertex_count);
+    for (uint32_t i = 0; i < edge_count;) {
+        uint32_t j = i + 1;
+        while (j < edge_count && self->edges[j].key == self->edges[i].key) j++;
+        const uint32_t ga = self->groups[self->edges[i].a];
+        const uint32_t gb = self->groups[self->edges[i].b];
+        if (j - i > 2) {
+            self->locked[ga] = true;
+            self->locked[gb] = true;
+        } else if (j - i == 1 || self->edges[i].a != self->edges[i + 1].a || self->edges[i].b != self->edges[i + 1].b) {
+            add_special(self, ga, gb);
+            add_special(self, gb, ga);
+        }
+        i = j;
+    }
+
+    /* interior groups have a single vertex, seam and border groups
+     * continue along exactly two edges, corners are locked */
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        if (self->groups[v] != v) continue;
+        const uint32_t count = self->special_counts[v];
+        if (count == 0 && self->sizes[v] != 1) self->locked[v] = true;
+        if (count != 0 && (count != 2 || self->sizes[v] > 2)) self->locked[v] = true;
+    }
+}
+static void consider_collapse(nusr_simplifier_t *self, uint32_t vertex, uint32_t target)
+{
+    const uint32_t group = self->groups[vertex];
+    const uint32_t target_group = self->groups[target];
+    if (self->locked[group] || group == target_group) return;
+    if (self->special_counts[group]
+        && self->specials[group * 2 + 0] != target_group
+        && self->specials[group * 2 + 1] != target_group) return;
+
+    /* the merged quadric is evaluated at the target position */
+    const float cost = quadric_error(&self->quadrics[group], &self->quadrics[target_group], self->mesh->positions[target]);
+    if (cost < self->costs[group]) {
+        self->costs[group] = cost;
+        self->targets[group] = target;
+    }
+}
+static void build_adjacency(nusr_simplifier_t *self)
+{
+    const uint32_t vertex_count = self->mesh->vertex_count;
+    memset(self->offsets, 0, sizeof(uint32_t) * (vertex_count + 1));
+    for (uint32_t i = 0; i < self->index_count; i++) {
+        self->offsets[self->indices[i] + 1]++;
+    }
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        self->offsets[v + 1] += self->offsets[v];
+    }
+
+    /* the first triangle index of each vertex is used as a cursor */
+    for (uint32_t i = 0; i < self->index_count; i++) {
+        self->adjacency[self->offsets[self->indices[i]]++] = i - i % 3;
+    }
+    for (uint32_t v = vertex_count; v > 0; v--) {
+        self->offsets[v] = self->offsets[v - 1];
+    }
+    self->offsets[0] = 0;
+}
+static uint32_t find_target(const nusr_simplifier_t *self, uint32_t vertex, uint32_t target_group)
+{
+    /* vertex of the target group sharing a triangle, seam vertices are
+     * moved to the target vertex on their side of the seam */
+    for (uint32_t a = self->offsets[vertex]; a < self->offsets[vertex + 1]; a++) {
+        const uint32_t *triangle = self->indices + self->adjacency[a];
+        for (uint32_t k = 0; k < 3; k++) {
+            if (self->groups[triangle[k]] == target_group) return triangle[k];
+        }
+    }
+    return UINT32_MAX;
+}
+static bool is_collapse_valid(const nusr_simplifier_t *self, uint32_t group, uint32_t target_group)
+{
+    /* every vertex of the group needs a target and the remaining triangles
+     * around it must not flip */
+    const nu_vec3_t *positions = self->mesh->positions;
+    uint32_t vertex = group;
+    do {
+        if (self->offsets[vertex] != self->offsets[vertex + 1]) {
+            const uint32_t target = find_target(self, vertex, target_group);
+            if (target == UINT32_MAX) return false;
+
+            for (uint32_t a = self->offsets[vertex]; a < self->offsets[vertex + 1]; a++) {
+                const uint32_t *triangle = self->indices + self->adjacency[a];
+                bool removed = false;
+                const float *moved[3];
+                for (uint32_t k = 0; k < 3; k++) {
+                    if (self->groups[triangle[k]] == target_group) removed = true;
+                    moved[k] = positions[triangle[k] == vertex ? target : triangle[k]];
+                }
+                if (removed) continue;
+
+                nu_vec3_t n0, n1;
+                triangle_normal(positions[triangle[0]], positions[triangle[1]], positions[triangle[2]], n0);
+                triangle_normal(moved[0], moved[1], moved[2], n1);
+                if (nu_vec3_dot(n0, n1) <= 0.0f) return false;
+            }
+        }
+        vertex = self->siblings[vertex];
+    } while (vertex != group);
+    return true;
+}
+static uint32_t collapse(nusr_simplifier_t *self, uint32_t group, uint32_t target_group)
+{
+    /* neighbourhoods are frozen until the next pass */
+    uint32_t removed = 0;
+    self->touched[target_group] = true;
+    uint32_t vertex = group;
+    do {
+        const uint32_t target = find_target(self, vertex, target_group);
+        for (uint32_t a = self->offsets[vertex]; a < self->offsets[vertex + 1]; a++) {
+            uint32_t *triangle = self->indices + self->adjacency[a];
+            bool degenerated = false;
+            for (uint32_t k = 0; k < 3; k++) {
+                self->touched[self->groups[triangle[k]]] = true;
+                if (self->groups[triangle[k]] == target_group) degenerated = true;
+                if (triangle[k] == vertex) triangle[k] = target;
+            }
+            removed += degenerated;
+        }
+        vertex = self->siblings[vertex];
+    } while (vertex != group);
+    quadric_add(&self->quadrics[target_group], &self->quadrics[group]);
+    return removed;
+}
+static void remove_degenerated_triangles(nusr_simplifier_t *self)
+{
+    /* triangles with two vertices at the same position */
+    uint32_t index_count = 0;
+    for (uint32_t t = 0; t < self->index_count; t += 3) {
+        const uint32_t g0 = self->groups[self->indices[t + 0]];
+        const uint32_t g1 = self->groups[self->indices[t + 1]];
+        const uint32_t g2 = self->groups[self->indices[t + 2]];
+        if (g0 == g1 || g1 == g2 || g2 == g0) continue;
+        memmove(self->indices + index_count, self->indices + t, sizeof(uint32_t) * 3);
+        index_count += 3;
+    }
+    self->index_count = index_count;
+}
+static uint32_t simplify_pass(nusr_simplifier_t *self, uint32_t target_index_count, float max_error)
+{
+    const uint32_t vertex_count = self->mesh->vertex_count;
+    classify_groups(self);
+
+    /* cheapest collapse of each group along its edges */
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        self->costs[v] = FLT_MAX;
+    }
+    for (uint32_t t = 0; t < self->index_count; t += 3) {
+        for (uint32_t k = 0; k < 3; k++) {
+            const uint32_t a = self->indices[t + k];
+            const uint32_t b = self->indices[t + (k + 1) % 3];
+            consider_collapse(self, a, b);
+            consider_collapse(self, b, a);
+        }
+    }
+    uint32_t collapse_count = 0;
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        if (self->costs[v] > max_error) continue;
+        self->collapses[collapse_count].cost = self->costs[v];
+        self->collapses[collapse_count].group = v;
+        self->collapses[collapse_count].target = self->groups[self->targets[v]];
+        collapse_count++;
+    }
+    qsort(self->collapses, collapse_count, sizeof(nusr_collapse_t), compare_collapses);
+
+    /* cheapest collapses first, until the target is reached */
+    build_adjacency(self);
+    memset(self->touched, 0, sizeof(bool) * vertex_count);
+    const uint32_t budget = (self->index_count - target_index_count + 2) / 3;
+    uint32_t removed = 0;
+    for (uint32_t c = 0; c < collapse_count && removed < budget; c++) {
+        const uint32_t group = self->collapses[c].group;
+        const uint32_t target_group = self->collapses[c].target;
+        if (self->touched[group] || self->touched[target_group]) continue;
+        if (!is_collapse_valid(self, group, target_group)) continue;
+        removed += collapse(self, group, target_group);
+    }
+
+    remove_degenerated_triangles(self);
+
+    return removed;
+}
+
+nu_result_t nusr_mesh_simplify(const nusr_mesh_t *mesh, uint32_t target_index_count, float max_error, nusr_mesh_t *dest)
+{
+    const uint32_t vertex_count = mesh->vertex_count;
+
+    nusr_simplifier_t self;
+    self.mesh = mesh;
+    self.index_count = mesh->index_count;
+    self.indices = (uint32_t*)nu_malloc(sizeof(uint32_t) * mesh->index_count);
+    memcpy(self.indices, mesh->indices, sizeof(uint32_t) * mesh->index_count);
+    self.groups = (uint32_t*)nu_malloc(sizeof(uint32_t) * vertex_count);
+    self.siblings = (uint32_t*)nu_malloc(sizeof(uint32_t) * vertex_count);
+    self.sizes = (uint32_t*)nu_malloc(sizeof(uint32_t) * vertex_count);
+    self.locked = (bool*)nu_malloc(sizeof(bool) * vertex_count);
+    self.special_counts = (uint32_t*)nu_malloc(sizeof(uint32_t) * vertex_count);
+    self.specials = (uint32_t*)nu_malloc(sizeof(uint32_t) * vertex_count * 2);
+    self.quadrics = (nusr_quadric_t*)nu_malloc(sizeof(nusr_quadric_t) * vertex_count);
+    self.edges = (nusr_edge_t*)nu_malloc(sizeof(nusr_edge_t) * mesh->index_count);
+    self.costs = (float*)nu_malloc(sizeof(float) * vertex_count);
+    self.targets = (uint32_t*)nu_malloc(sizeof(uint32_t) * vertex_count);
+    self.collapses = (nusr_collapse_t*)nu_malloc(sizeof(nusr_collapse_t) * vertex_count);
+    self.offsets = (uint32_t*)nu_malloc(sizeof(uint32_t) * (vertex_count + 1));
+    self.adjacency = (uint32_t*)nu_malloc(sizeof(uint32_t) * mesh->index_count);
+    self.touched = (bool*)nu_malloc(sizeof(bool) * vertex_count);
+
+    weld_positions(&self);
+    remove_degenerated_triangles(&self);
+
+    /* plane quadrics of the source triangles */
+    memset(self.quadrics, 0, sizeof(nusr_quadric_t) * vertex_count);
+    for (uint32_t t = 0; t < mesh->index_count; t += 3) {
+        const uint32_t *triangle = mesh->indices + t;
+        nusr_quadric_t q;
+        quadric_from_triangle(mesh->positions[triangle[0]], mesh->positions[triangle[1]], mesh->positions[triangle[2]], &q);
+        for (uint32_t k = 0; k < 3; k++) {
+            quadric_add(&self.quadrics[self.groups[triangle[k]]], &q);
+        }
+    }
+
+    /* passes stop when every remaining collapse is locked or flips triangles */
+    for (uint32_t pass = 0; pass < MAX_PASS_COUNT && self.index_count > target_index_count; pass++) {
+        if (!simplify_pass(&self, target_index_count, max_error * max_error)) break;
+    }
+
+    nu_free(self.groups);
+    nu_free(self.siblings);
+    nu_free(self.sizes);
+    nu_free(self.locked);
+    nu_free(self.special_counts);
+    nu_free(self.specials);
+    nu_free(self.quadrics);
+    nu_free(self.edges);
+    nu_free(self.costs);
+    nu_free(self.collapses);
+    nu_free(self.offsets);
+    nu_free(self.adjacency);
+    nu_free(self.touched);
+
+    if (self.index_count == mesh->index_count) {
+        nu_free(self.targets);
+        nu_free(self.indices);
+        return NU_FAILURE;
+    }
+
+    /* keep referenced vertices in first use order */
+    uint32_t *remap = self.targets;
+    memset(remap, 0xFF, sizeof(uint32_t) * vertex_count);
+    dest->vertex_count = 0;
+    for (uint32_t i = 0; i < self.index_count; i++) {
+        if (remap[self.indices[i]] == UINT32_MAX) remap[self.indices[i]] = dest->vertex_count++;
+    }
+    dest->positions = (nu_vec3_t*)nu_malloc(sizeof(nu_vec3_t) * dest->vertex_count);
+    dest->uvs = (nu_vec2_t*)nu_malloc(sizeof(nu_vec2_t) * dest->vertex_count);
+    dest->colors = mesh->colors ? (nu_vec3_t*)nu_malloc(sizeof(nu_vec3_t) * dest->vertex_count) : NULL;
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        if (remap[v] == UINT32_MAX) continue;
+        nu_vec3_copy(mesh->positions[v], dest->positions[remap[v]]);
+        nu_vec2_copy(mesh->uvs[v], dest->uvs[remap[v]]);
+        if (dest->colors) nu_vec3_copy(mesh->colors[v], dest->colors[remap[v]]);
+    }
+    dest->index_count = self.index_count;
+    dest->indices = (uint32_t*)nu_malloc(sizeof(uint32_t) * self.index_count);
+    for (uint32_t i = 0; i < self.index_count; i++) {
+        dest->indices[i] = remap[self.indices[i]];
+    }
+    nu_free(self.targets);
+    nu_free(self.indices);
+
+    /* the source bounds are kept so culling and sorting do not change
+     * with the level */
+    dest->xmax = mesh->xmax;
+    dest->xmin = mesh->xmin;
+    dest->ymax = mesh->ymax;
+    dest->ymin = mesh->ymin;
+    dest->zmax = mesh->zmax;
+    dest->zmin = mesh->zmin;
+    dest->lods = NULL;
+    dest->lod_count = 0;
+
+    return NU_SUCCESS;
+}
\ No newline at end of file
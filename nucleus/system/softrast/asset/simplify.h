@@ -0,0 +1,12 @@
+#ifndef NUSR_SIMPLIFY_H
+#define NUSR_SIMPLIFY_H
+
+#include "mesh.h"
+
+/* quadric edge collapse decimation, vertices are collapsed onto one of
+ * their neighbours so the simplified mesh keeps a subset of the source
+ * vertices and their attributes, collapses moving the surface further
+ * than max_error are rejected, fails when no triangle can be removed */
+nu_result_t nusr_mesh_simplify(const nusr_mesh_t *mesh, uint32_t target_index_count, float max_error, nusr_mesh_t *dest);
+
+#endif
\ No newline at end of file
@@ -1,29 +1,111 @@
 #include "texture.h"
 
+#include "../common/config.h"
+
 #define MAX_TEXTURE_COUNT 32
 
 typedef struct {
     nusr_texture_t **textures;
     uint32_t next_id;
+    bool swizzle;
 } nusr_asset_texture_data_t;
 
 static nusr_asset_texture_data_t _data;
 
+static void build_level(const nusr_texture_level_t *src, nusr_texture_level_t *dst)
+{
+    dst->width = NU_MAX(1, src->width / 2);
+    dst->height = NU_MAX(1, src->height / 2);
+    dst->swizzled = false;
+    dst->morton_bits = 0;
+    dst->data = (uint32_t*)nu_malloc(sizeof(uint32_t) * dst->width * dst->height);
+
+    /* 2x2 box filter, odd sizes reuse the last row or column */
+    for (uint32_t y = 0; y < dst->height; y++) {
+        const uint32_t *row0 = src->data + NU_MIN(y * 2 + 0, src->height - 1) * src->width;
+        const uint32_t *row1 = src->data + NU_MIN(y * 2 + 1, src->height - 1) * src->width;
+        for (uint32_t x = 0; x < dst->width; x++) {
+            uint32_t x0 = NU_MIN(x * 2 + 0, src->width - 1);
+            uint32_t x1 = NU_MIN(x * 2 + 1, src->width - 1);
+            uint32_t color = 0;
+            for (uint32_t shift = 8; shift < 32; shift += 8) {
+                uint32_t sum = ((row0[x0] >> shift) & 0xFF) + ((row0[x1] >> shift) & 0xFF)
+                    + ((row1[x0] >> shift) & 0xFF) + ((row1[x1] >> shift) & 0xFF);
+                color |= ((sum + 2) / 4) << shift;
+            }
+            dst->data[y * dst->width + x] = color;
+        }
+    }
+}
+static uint32_t morton_spread(uint32_t v)
+{
+    /* insert a zero bit between each of the 16 low bits */
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+static void swizzle_level(nusr_texture_level_t *level)
+{
+    /* padded power of two storage */
+    uint32_t width = 1, height = 1;
+    while (width < level->width) width <<= 1;
+    while (height < level->height) height <<= 1;
+    level->morton_bits = 0;
+    while ((2u << level->morton_bits) <= NU_MIN(width, height)) level->morton_bits++;
+
+    /* padding texels are never sampled since coordinates are clamped */
+    const uint32_t k = level->morton_bits;
+    const uint32_t mask = (1u << k) - 1;
+    uint32_t *data = (uint32_t*)nu_malloc(sizeof(uint32_t) * width * height);
+    memset(data, 0, sizeof(uint32_t) * width * height);
+    for (uint32_t y = 0; y < level->height; y++) {
+        for (uint32_t x = 0; x < level->width; x++) {
+            uint32_t index = morton_spread(x & mask) | (morton_spread(y & mask) << 1) | (((x | y) >> k) << (2 * k));
+            data[index] = level->data[y * level->width + x];
+        }
+    }
+
+    nu_free(level->data);
+    level->data = data;
+    level->swizzled = true;
+}
 static nu_result_t create_texture(uint32_t *id, const nu_renderer_texture_create_info_t *info)
 {
     /* error check */
     if (_data.next_id >= MAX_TEXTURE_COUNT) return NU_FAILURE;
 
     /* create texture */
-    _data.textures[_data.next_id] = (nusr_texture_t*)nu_malloc(sizeof(nusr_texture_t));
-    _data.textures[_data.next_id]->height = info->height;
-    _data.textures[_data.next_id]->width = info->width;
+    nusr_texture_t *texture = (nusr_texture_t*)nu_malloc(sizeof(nusr_texture_t));
+    _data.textures[_data.next_id] = texture;
+    texture->filter = info->filter;
+    nusr_texture_level_t *base = &texture->levels[0];
+    base->height = info->height;
+    base->width = info->width;
+    base->swizzled = false;
+    base->morton_bits = 0;
 
     /* allocate memory */
-    _data.textures[_data.next_id]->data = (uint32_t*)nu_malloc(sizeof(uint32_t) * info->width * info->height);
+    base->data = (uint32_t*)nu_malloc(sizeof(uint32_t) * info->width * info->height);
     for (uint32_t p = 0; p < info->width * info->height; p++) {
         uint32_t color = ((uint32_t)(info->data[p * 3 + 0]) << 24) + ((uint32_t)(info->data[p * 3 + 1]) << 16) + ((uint32_t)(info->data[p * 3 + 2]) << 8);
-        _data.textures[_data.next_id]->data[p] = color;
+        base->data[p] = color;
+    }
+
+    /* build mip chain down to 1x1 */
+    texture->level_count = 1;
+    while (texture->level_count < NUSR_TEXTURE_MAX_LEVEL_COUNT) {
+        const nusr_texture_level_t *previous = &texture->levels[texture->level_count - 1];
+        if (previous->width == 1 && previous->height == 1) break;
+        build_level(previous, &texture->levels[texture->level_count++]);
+    }
+
+    /* convert levels once the chain is built from row major data */
+    if (_data.swizzle) {
+        for (uint32_t i = 0; i < texture->level_count; i++) {
+            swizzle_level(&texture->levels[i]);
+        }
     }
 
     /* save id */
@@ -36,7 +118,9 @@ static nu_result_t destroy_texture(uint32_t id)
     if (_data.next_id >= MAX_TEXTURE_COUNT) return NU_FAILURE;
     if (!_data.textures[id]) return NU_FAILURE;
 
-    nu_free(_data.textures[id]->data);
+    for (uint32_t i = 0; i < _data.textures[id]->level_count; i++) {
+        nu_free(_data.textures[id]->levels[i].data);
+    }
     nu_free(_data.textures[id]);
     _data.textures[id] = NULL;
 
@@ -46,6 +130,7 @@ static nu_result_t destroy_texture(uint32_t id)
 nu_result_t nusr_texture_initialize(void)
 {
     _data.next_id = 0;
+    nu_config_get_bool(NUSR_CONFIG_SOFTRAST_SECTION, NUSR_CONFIG_SOFTRAST_TEXTURE_SWIZZLE, &_data.swizzle, false);
     _data.textures = (nusr_texture_t**)nu_malloc(sizeof(nusr_texture_t*) * MAX_TEXTURE_COUNT);
     memset(_data.textures, 0, sizeof(nusr_texture_t*) * MAX_TEXTURE_COUNT);
 
@@ -3,10 +3,25 @@
 
 #include "../module/interface.h"
 
+/* enough levels for 32768 texels wide textures */
+#define NUSR_TEXTURE_MAX_LEVEL_COUNT 16
+
 typedef struct {
     uint32_t width;
     uint32_t height;
+    /* swizzled levels are stored in morton order, padded to power of two
+     * sizes: the low morton_bits of x and y are interleaved and the high
+     * bits of the larger dimension are appended */
+    bool swizzled;
+    uint32_t morton_bits;
     uint32_t *data;
+} nusr_texture_level_t;
+
+typedef struct {
+    nu_renderer_texture_filter_t filter;
+    /* mip chain, level 0 is the full resolution image */
+    uint32_t level_count;
+    nusr_texture_level_t levels[NUSR_TEXTURE_MAX_LEVEL_COUNT];
 } nusr_texture_t;
 
 nu_result_t nusr_texture_initialize(void);
@@ -4,5 +4,13 @@
 #define NUSR_CONFIG_SOFTRAST_SECTION            "softrast"
 #define NUSR_CONFIG_SOFTRAST_FRAMEBUFFER_WIDTH  "framebuffer_width"
 #define NUSR_CONFIG_SOFTRAST_FRAMEBUFFER_HEIGHT "framebuffer_height"
+#define NUSR_CONFIG_SOFTRAST_OCCLUSION_CULLING  "occlusion_culling"
+#define NUSR_CONFIG_SOFTRAST_TEXTURE_SWIZZLE    "texture_swizzle"
+#define NUSR_CONFIG_SOFTRAST_VISIBILITY_BUFFER  "visibility_buffer"
+#define NUSR_CONFIG_SOFTRAST_DEPTH_FORMAT       "depth_format"
+#define NUSR_CONFIG_SOFTRAST_MSAA               "msaa"
+#define NUSR_CONFIG_SOFTRAST_DYNAMIC_RESOLUTION "dynamic_resolution"
+#define NUSR_CONFIG_SOFTRAST_TARGET_FRAME_TIME  "target_frame_time"
+#define NUSR_CONFIG_SOFTRAST_LOD_SCREEN_SIZE    "lod_screen_size"
 
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "gui.h"
 
 #include "render.h"
+#include "../viewport/viewport.h"
 
 #define MAX_LABEL_COUNT 512
 #define MAX_RECTANGLE_COUNT 128
@@ -39,21 +40,113 @@ nu_result_t nusr_gui_terminate(void)
 
     return NU_SUCCESS;
 }
+static void buffer_scale(const nusr_framebuffer_t *color_buffer, float *sx, float *sy)
+{
+    /* positions are given in viewport pixels, the color buffer may use a
+     * lower internal resolution (glyphs keep their size) */
+    uint32_t width, height;
+    nusr_viewport_get_size(&width, &height);
+    *sx = (float)color_buffer->width / (float)width;
+    *sy = (float)color_buffer->height / (float)height;
+}
+static nu_rect_t scale_rectangle(nu_rect_t rect, float sx, float sy)
+{
+    rect.left *= sx;
+    rect.top *= sy;
+    rect.width *= sx;
+    rect.height *= sy;
+    return rect;
+}
+static void label_bounds(const nusr_label_t *label, float sx, float sy, int32_t bounds[4])
+{
+    /* glyphs are drawn around the baseline, the text height is used on
+     * both sides to include descenders */
+    uint32_t width, height;
+    nusr_font_get_text_size((nu_renderer_font_handle_t)(uint64_t)label->font, label->text, &width, &height);
+    bounds[0] = (int32_t)(label->x * sx);
+    bounds[1] = (int32_t)(label->y * sy) - (int32_t)height;
+    bounds[2] = bounds[0] + (int32_t)width + 1;
+    bounds[3] = (int32_t)(label->y * sy) + (int32_t)height + 1;
+}
+static void invalidate_area(nusr_renderbuffer_t *renderbuffer, const int32_t bounds[4])
+{
+    /* gui rows go top-down while framebuffer rows are stored bottom-up */
+    const int32_t height = (int32_t)renderbuffer->color_buffer.height;
+    nusr_renderbuffer_invalidate_area(renderbuffer, bounds[0], height - bounds[3], bounds[2], height - bounds[1]);
+}
+static void rectangle_bounds(nu_rect_t rect, int32_t bounds[4])
+{
+    /* pixels drawn by nusr_gui_render_rectangle (max excluded) */
+    bounds[0] = rect.left;
+    bounds[1] = rect.top;
+    bounds[2] = rect.left + (int32_t)rect.width;
+    bounds[3] = rect.top + (int32_t)rect.height;
+}
+static void invalidate_label(const nusr_label_t *label)
+{
+    /* bounds depend on the internal resolution of each renderbuffer */
+    nusr_renderbuffer_t *renderbuffers;
+    uint32_t count;
+    nusr_viewport_get_renderbuffers(&renderbuffers, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        float sx, sy;
+        buffer_scale(&renderbuffers[i].color_buffer, &sx, &sy);
+        int32_t bounds[4];
+        label_bounds(label, sx, sy, bounds);
+        invalidate_area(&renderbuffers[i], bounds);
+    }
+}
+static void invalidate_rectangle(const nusr_rectangle_t *rectangle)
+{
+    /* viewport areas are given with bottom-up rows too */
+    uint32_t width, height;
+    nusr_viewport_get_size(&width, &height);
+    int32_t bounds[4];
+    rectangle_bounds(rectangle->rect, bounds);
+    nusr_viewport_invalidate_area(bounds[0], (int32_t)height - bounds[3], bounds[2], (int32_t)height - bounds[1]);
+}
+
 nu_result_t nusr_gui_render(nusr_framebuffer_t *color_buffer)
 {
+    float sx, sy;
+    buffer_scale(color_buffer, &sx, &sy);
+
     /* draw labels */
     for (uint32_t id = 0; id < _data.label_count; id++) {
         if (_data.labels[id].active) {
             nusr_font_t *font;
             nusr_font_get(_data.labels[id].font, &font);
-            nusr_gui_render_label(color_buffer, _data.labels[id].x, _data.labels[id].y, font, _data.labels[id].text);
+            nusr_gui_render_label(color_buffer, _data.labels[id].x * sx, _data.labels[id].y * sy, font, _data.labels[id].text);
         }
     }
 
     /* draw rectangles */
     for (uint32_t id = 0; id < _data.rectangle_count; id++) {
         if (_data.rectangles[id].active) {
-            nusr_gui_render_rectangle(color_buffer, _data.rectangles[id].rect, _data.rectangles[id].color);
+            nusr_gui_render_rectangle(color_buffer, scale_rectangle(_data.rectangles[id].rect, sx, sy), _data.rectangles[id].color);
+        }
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_gui_invalidate_tiles(nusr_renderbuffer_t *renderbuffer)
+{
+    /* the gui is drawn over the scene, tiles below it are redrawn with the
+     * frame so elements are never drawn twice on the same pixels */
+    float sx, sy;
+    buffer_scale(&renderbuffer->color_buffer, &sx, &sy);
+    for (uint32_t id = 0; id < _data.label_count; id++) {
+        if (_data.labels[id].active) {
+            int32_t bounds[4];
+            label_bounds(&_data.labels[id], sx, sy, bounds);
+            invalidate_area(renderbuffer, bounds);
+        }
+    }
+    for (uint32_t id = 0; id < _data.rectangle_count; id++) {
+        if (_data.rectangles[id].active) {
+            int32_t bounds[4];
+            rectangle_bounds(scale_rectangle(_data.rectangles[id].rect, sx, sy), bounds);
+            invalidate_area(renderbuffer, bounds);
         }
     }
 
@@ -81,6 +174,7 @@ nu_result_t nusr_gui_label_create(nu_renderer_label_handle_t *handle, const nu_r
     _data.labels[found_id].y = info->y;
     _data.labels[found_id].font = (uint64_t)info->font;
     strncpy(_data.labels[found_id].text, info->text, NUSR_MAX_LABEL_TEXT_SIZE - 1); 
+    invalidate_label(&_data.labels[found_id]);
 
     *((uint32_t*)handle) = found_id;
 
@@ -92,6 +186,7 @@ nu_result_t nusr_gui_label_destroy(nu_renderer_label_handle_t handle)
 
     if (!_data.labels[id].active) return NU_FAILURE;
 
+    invalidate_label(&_data.labels[id]);
     _data.labels[id].active = false;
 
     return NU_SUCCESS;
@@ -102,8 +197,12 @@ nu_result_t nusr_gui_label_set_position(nu_renderer_label_handle_t handle, int32
 
     if (!_data.labels[id].active) return NU_FAILURE;
 
+    if (_data.labels[id].x == x && _data.labels[id].y == y) return NU_SUCCESS;
+
+    invalidate_label(&_data.labels[id]);
     _data.labels[id].x = x;
     _data.labels[id].y = y;
+    invalidate_label(&_data.labels[id]);
 
     return NU_SUCCESS;
 }
@@ -113,7 +212,11 @@ nu_result_t nusr_gui_label_set_text(nu_renderer_label_handle_t handle, const cha
 
     if (!_data.labels[id].active) return NU_FAILURE;
 
+    if (!strncmp(_data.labels[id].text, text, NUSR_MAX_LABEL_TEXT_SIZE - 1)) return NU_SUCCESS;
+
+    invalidate_label(&_data.labels[id]);
     strncpy(_data.labels[id].text, text, NUSR_MAX_LABEL_TEXT_SIZE - 1);
+    invalidate_label(&_data.labels[id]);
 
     return NU_SUCCESS;
 }
@@ -137,6 +240,7 @@ nu_result_t nusr_gui_rectangle_create(nu_renderer_rectangle_handle_t *handle, co
     _data.rectangles[found_id].active = true;
     _data.rectangles[found_id].rect = info->rect;
     _data.rectangles[found_id].color = info->color;
+    invalidate_rectangle(&_data.rectangles[found_id]);
 
     *((uint32_t*)handle) = found_id;
 
@@ -148,6 +252,7 @@ nu_result_t nusr_gui_rectangle_destroy(nu_renderer_rectangle_handle_t handle)
 
     if (!_data.rectangles[id].active) return NU_FAILURE;
 
+    invalidate_rectangle(&_data.rectangles[id]);
     _data.rectangles[id].active = false;
 
     return NU_SUCCESS;
@@ -158,7 +263,9 @@ nu_result_t nusr_gui_rectangle_set_rect(nu_renderer_rectangle_handle_t handle, n
 
     if (!_data.rectangles[id].active) return NU_FAILURE;
 
+    invalidate_rectangle(&_data.rectangles[id]);
     _data.rectangles[id].rect = rect;
+    invalidate_rectangle(&_data.rectangles[id]);
 
     return NU_SUCCESS;
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 #ifndef NUSR_GUI_H
 #define NUSR_GUI_H
 
-#include "../memory/framebuffer.h"
+#include "../memory/renderbuffer.h"
 #include "../asset/font.h"
 
 #define NUSR_MAX_LABEL_TEXT_SIZE 512
@@ -23,6 +23,7 @@ typedef struct {
 nu_result_t nusr_gui_initialize(void);
 nu_result_t nusr_gui_terminate(void);
 nu_result_t nusr_gui_render(nusr_framebuffer_t *color_buffer);
+nu_result_t nusr_gui_invalidate_tiles(nusr_renderbuffer_t *renderbuffer);
 
 nu_result_t nusr_gui_label_create(nu_renderer_label_handle_t *handle, const nu_renderer_label_create_info_t *info);
 nu_result_t nusr_gui_label_destroy(nu_renderer_label_handle_t handle);
@@ -1,5 +1,25 @@
 #include "framebuffer.h"
 
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+static void fill_pixels(nusr_framebuffer_pixel_t *pixels, uint32_t count, uint32_t value, bool stream)
+{
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    /* aligned 16 bytes stores, streamed ones bypass the cache */
+    for (; i < count && ((uintptr_t)(pixels + i) & 15); i++) pixels[i].as_uint = value;
+    const __m128i v = _mm_set1_epi32(value);
+    if (stream) {
+        for (; i + 4 <= count; i += 4) _mm_stream_si128((__m128i*)(pixels + i), v);
+    } else {
+        for (; i + 4 <= count; i += 4) _mm_store_si128((__m128i*)(pixels + i), v);
+    }
+#endif
+    for (; i < count; i++) pixels[i].as_uint = value;
+}
+
 nu_result_t nusr_framebuffer_create(nusr_framebuffer_t *self, uint32_t width, uint32_t height)
 {
     self->pixels = (nusr_framebuffer_pixel_t*)nu_malloc(sizeof(nusr_framebuffer_pixel_t) * width * height);
@@ -19,7 +39,40 @@ nu_result_t nusr_framebuffer_destroy(nusr_framebuffer_t *self)
 }
 nu_result_t nusr_framebuffer_clear(nusr_framebuffer_t *self, uint32_t color)
 {
-    memset(self->pixels, color, sizeof(nusr_framebuffer_pixel_t) * self->width * self->height);
+    /* the whole buffer is not read back soon, keep it out of the cache */
+    fill_pixels(self->pixels, self->width * self->height, color, true);
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_framebuffer_clear_area(nusr_framebuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    uint32_t value
+)
+{
+    /* rows are given in memory order */
+    for (uint32_t y = ymin; y < ymax; y++) {
+        fill_pixels(self->pixels + y * self->width + xmin, xmax - xmin, value, false);
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_framebuffer_stream_area(nusr_framebuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    uint32_t value
+)
+{
+    /* same as clear_area with non-temporal stores */
+    for (uint32_t y = ymin; y < ymax; y++) {
+        fill_pixels(self->pixels + y * self->width + xmin, xmax - xmin, value, true);
+    }
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
 
     return NU_SUCCESS;
 }
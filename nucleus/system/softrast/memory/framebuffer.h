@@ -17,6 +17,16 @@ typedef struct {
 nu_result_t nusr_framebuffer_create(nusr_framebuffer_t *self, uint32_t width, uint32_t height);
 nu_result_t nusr_framebuffer_destroy(nusr_framebuffer_t *self);
 nu_result_t nusr_framebuffer_clear(nusr_framebuffer_t *self, uint32_t color);
+nu_result_t nusr_framebuffer_clear_area(nusr_framebuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    uint32_t value
+);
+nu_result_t nusr_framebuffer_stream_area(nusr_framebuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    uint32_t value
+);
 nu_result_t nusr_framebuffer_set_rgb(nusr_framebuffer_t *self,
     uint32_t x, uint32_t y,
     float r, float g, float b
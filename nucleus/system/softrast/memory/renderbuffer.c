@@ -1,16 +1,287 @@
 #include "renderbuffer.h"
 
-nu_result_t nusr_renderbuffer_create(nusr_renderbuffer_t *self, uint32_t width, uint32_t height)
+#include <float.h>
+
+nu_result_t nusr_renderbuffer_create(nusr_renderbuffer_t *self,
+    uint32_t width, uint32_t height,
+    nusr_depth_format_t depth_format,
+    uint32_t sample_count
+)
 {
+    if (width > NUSR_RENDERBUFFER_MAX_SIZE || height > NUSR_RENDERBUFFER_MAX_SIZE) return NU_FAILURE;
+
     nusr_framebuffer_create(&self->color_buffer, width, height);
-    nusr_framebuffer_create(&self->depth_buffer, width, height);
+
+    /* sample planes are stacked vertically */
+    self->sample_count = sample_count;
+    self->sample_stride = width * height;
+    if (sample_count > 1) {
+        nusr_framebuffer_create(&self->sample_buffer, width, height * sample_count);
+    } else {
+        memset(&self->sample_buffer, 0, sizeof(nusr_framebuffer_t));
+    }
+
+    /* depth buffer */
+    self->depth_format = depth_format;
+    if (depth_format == NUSR_DEPTH_FORMAT_UNORM16) {
+        memset(&self->depth_buffer, 0, sizeof(nusr_framebuffer_t));
+        self->depth16 = (uint16_t*)nu_malloc(sizeof(uint16_t) * width * height * sample_count);
+    } else {
+        nusr_framebuffer_create(&self->depth_buffer, width, height * sample_count);
+        self->depth16 = NULL;
+    }
+
+    /* coarse depth blocks */
+    self->hiz_width = (width + NUSR_RENDERBUFFER_HIZ_SIZE - 1) / NUSR_RENDERBUFFER_HIZ_SIZE;
+    self->hiz_height = (height + NUSR_RENDERBUFFER_HIZ_SIZE - 1) / NUSR_RENDERBUFFER_HIZ_SIZE;
+    self->hiz_max_depth = (float*)nu_malloc(sizeof(float) * self->hiz_width * self->hiz_height);
+    self->hiz_dirty = (bool*)nu_malloc(sizeof(bool) * self->hiz_width * self->hiz_height);
+    nusr_renderbuffer_clear_depth_area(self, 0, 0, width, height);
+
+    /* deferred clears */
+    self->tile_count_x = (width + NUSR_RENDERBUFFER_TILE_SIZE - 1) / NUSR_RENDERBUFFER_TILE_SIZE;
+    self->tile_count_y = (height + NUSR_RENDERBUFFER_TILE_SIZE - 1) / NUSR_RENDERBUFFER_TILE_SIZE;
+    self->tile_clear_pending = (bool*)nu_malloc(sizeof(bool) * self->tile_count_x * self->tile_count_y);
+    memset(self->tile_clear_pending, 0, sizeof(bool) * self->tile_count_x * self->tile_count_y);
+    nusr_framebuffer_clear(&self->color_buffer, NUSR_RENDERBUFFER_CLEAR_COLOR);
+
+    /* the first frame draws every tile */
+    self->tile_dirty = (bool*)nu_malloc(sizeof(bool) * self->tile_count_x * self->tile_count_y);
+    memset(self->tile_dirty, 1, sizeof(bool) * self->tile_count_x * self->tile_count_y);
 
     return NU_SUCCESS;
 }
 nu_result_t nusr_renderbuffer_destroy(nusr_renderbuffer_t *self)
 {
     nusr_framebuffer_destroy(&self->color_buffer);
-    nusr_framebuffer_destroy(&self->depth_buffer);
+    if (self->sample_count > 1) {
+        nusr_framebuffer_destroy(&self->sample_buffer);
+    }
+    if (self->depth16) {
+        nu_free(self->depth16);
+    } else {
+        nusr_framebuffer_destroy(&self->depth_buffer);
+    }
+    nu_free(self->hiz_max_depth);
+    nu_free(self->hiz_dirty);
+    nu_free(self->tile_clear_pending);
+    nu_free(self->tile_dirty);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_renderbuffer_clear_color_area(nusr_renderbuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    uint32_t color
+)
+{
+    /* multisampled colors are written by the resolve */
+    if (self->sample_count == 1) {
+        return nusr_framebuffer_clear_area(&self->color_buffer, xmin, ymin, xmax, ymax, color);
+    }
+    const uint32_t height = self->color_buffer.height;
+    for (uint32_t s = 0; s < self->sample_count; s++) {
+        nusr_framebuffer_clear_area(&self->sample_buffer, xmin, s * height + ymin, xmax, s * height + ymax, color);
+    }
 
     return NU_SUCCESS;
+}
+nu_result_t nusr_renderbuffer_resolve_samples_area(nusr_renderbuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+)
+{
+    /* average samples, channels are summed in 16 bits lanes */
+    const uint32_t width = self->color_buffer.width;
+    const nusr_framebuffer_pixel_t *samples = self->sample_buffer.pixels;
+    for (uint32_t y = ymin; y < ymax; y++) {
+        for (uint32_t x = xmin; x < xmax; x++) {
+            uint32_t index = y * width + x;
+            uint32_t even = 0, odd = 0;
+            for (uint32_t s = 0; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+                uint32_t c = samples[s * self->sample_stride + index].as_uint;
+                even += c & 0x00FF00FF;
+                odd += (c >> 8) & 0x00FF00FF;
+            }
+            even = (even >> 2) & 0x00FF00FF;
+            odd = (odd >> 2) & 0x00FF00FF;
+            self->color_buffer.pixels[index].as_uint = even | (odd << 8);
+        }
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_renderbuffer_clear_depth_area(nusr_renderbuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+)
+{
+    /* clear every sample to the farthest value of the format */
+    uint32_t value;
+    float hiz_depth;
+    switch (self->depth_format) {
+        case NUSR_DEPTH_FORMAT_FLOAT32_REVERSED:
+            value = 0x0;
+            hiz_depth = 0.0f;
+            break;
+        case NUSR_DEPTH_FORMAT_UNORM24:
+            value = NUSR_DEPTH_UNORM24_MAX;
+            hiz_depth = (float)NUSR_DEPTH_UNORM24_MAX;
+            break;
+        case NUSR_DEPTH_FORMAT_UNORM16:
+            value = NUSR_DEPTH_UNORM16_MAX;
+            hiz_depth = (float)NUSR_DEPTH_UNORM16_MAX;
+            break;
+        default:
+            value = 0x7F7FFFFF; /* max float value */
+            hiz_depth = FLT_MAX;
+            break;
+    }
+    const uint32_t height = self->color_buffer.height;
+    for (uint32_t s = 0; s < self->sample_count; s++) {
+        if (self->depth16) {
+            for (uint32_t y = ymin; y < ymax; y++) {
+                uint16_t *row = self->depth16 + s * self->sample_stride + y * self->color_buffer.width;
+                for (uint32_t x = xmin; x < xmax; x++) {
+                    row[x] = value;
+                }
+            }
+        } else {
+            nusr_framebuffer_clear_area(&self->depth_buffer, xmin, s * height + ymin, xmax, s * height + ymax, value);
+        }
+    }
+    nusr_renderbuffer_clear_hiz_area(self, xmin, ymin, xmax, ymax, hiz_depth);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_renderbuffer_clear_hiz_area(nusr_renderbuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    float depth
+)
+{
+    /* the area must be cleared with the same depth in the depth buffer */
+    uint32_t hxmax = (xmax + NUSR_RENDERBUFFER_HIZ_SIZE - 1) / NUSR_RENDERBUFFER_HIZ_SIZE;
+    uint32_t hymax = (ymax + NUSR_RENDERBUFFER_HIZ_SIZE - 1) / NUSR_RENDERBUFFER_HIZ_SIZE;
+    for (uint32_t hy = ymin / NUSR_RENDERBUFFER_HIZ_SIZE; hy < hymax; hy++) {
+        for (uint32_t hx = xmin / NUSR_RENDERBUFFER_HIZ_SIZE; hx < hxmax; hx++) {
+            self->hiz_max_depth[hy * self->hiz_width + hx] = depth;
+            self->hiz_dirty[hy * self->hiz_width + hx] = false;
+        }
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_renderbuffer_defer_clear_area(nusr_renderbuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+)
+{
+    /* the area must be aligned on tiles, the color and depth buffers are
+     * left as is until the resolve */
+    uint32_t txmax = (xmax + NUSR_RENDERBUFFER_TILE_SIZE - 1) / NUSR_RENDERBUFFER_TILE_SIZE;
+    uint32_t tymax = (ymax + NUSR_RENDERBUFFER_TILE_SIZE - 1) / NUSR_RENDERBUFFER_TILE_SIZE;
+    for (uint32_t ty = ymin / NUSR_RENDERBUFFER_TILE_SIZE; ty < tymax; ty++) {
+        for (uint32_t tx = xmin / NUSR_RENDERBUFFER_TILE_SIZE; tx < txmax; tx++) {
+            self->tile_clear_pending[ty * self->tile_count_x + tx] = true;
+        }
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_renderbuffer_resolve(nusr_renderbuffer_t *self)
+{
+    /* fill runs of pending tiles row by row with streamed stores */
+    const uint32_t width = self->color_buffer.width;
+    const uint32_t height = self->color_buffer.height;
+    for (uint32_t ty = 0; ty < self->tile_count_y; ty++) {
+        bool *pending = self->tile_clear_pending + ty * self->tile_count_x;
+        uint32_t tx = 0;
+        while (tx < self->tile_count_x) {
+            if (!pending[tx]) {
+                tx++;
+                continue;
+            }
+            uint32_t first = tx;
+            while (tx < self->tile_count_x && pending[tx]) pending[tx++] = false;
+            nusr_framebuffer_stream_area(&self->color_buffer,
+                first * NUSR_RENDERBUFFER_TILE_SIZE, ty * NUSR_RENDERBUFFER_TILE_SIZE,
+                NU_MIN(tx * NUSR_RENDERBUFFER_TILE_SIZE, width), NU_MIN((ty + 1) * NUSR_RENDERBUFFER_TILE_SIZE, height),
+                NUSR_RENDERBUFFER_CLEAR_COLOR
+            );
+        }
+    }
+
+    return NU_SUCCESS;
+}
+static bool area_tiles(const nusr_renderbuffer_t *self,
+    int32_t xmin, int32_t ymin,
+    int32_t xmax, int32_t ymax,
+    uint32_t tiles[4]
+)
+{
+    /* clamp a pixel area (max excluded) to the tile grid */
+    xmin = NU_MAX(xmin, 0);
+    ymin = NU_MAX(ymin, 0);
+    xmax = NU_MIN(xmax, (int32_t)self->color_buffer.width);
+    ymax = NU_MIN(ymax, (int32_t)self->color_buffer.height);
+    if (xmin >= xmax || ymin >= ymax) return false;
+    tiles[0] = xmin / NUSR_RENDERBUFFER_TILE_SIZE;
+    tiles[1] = ymin / NUSR_RENDERBUFFER_TILE_SIZE;
+    tiles[2] = (xmax + NUSR_RENDERBUFFER_TILE_SIZE - 1) / NUSR_RENDERBUFFER_TILE_SIZE;
+    tiles[3] = (ymax + NUSR_RENDERBUFFER_TILE_SIZE - 1) / NUSR_RENDERBUFFER_TILE_SIZE;
+    return true;
+}
+nu_result_t nusr_renderbuffer_invalidate_area(nusr_renderbuffer_t *self,
+    int32_t xmin, int32_t ymin,
+    int32_t xmax, int32_t ymax
+)
+{
+    uint32_t tiles[4];
+    if (!area_tiles(self, xmin, ymin, xmax, ymax, tiles)) return NU_SUCCESS;
+    for (uint32_t ty = tiles[1]; ty < tiles[3]; ty++) {
+        for (uint32_t tx = tiles[0]; tx < tiles[2]; tx++) {
+            self->tile_dirty[ty * self->tile_count_x + tx] = true;
+        }
+    }
+
+    return NU_SUCCESS;
+}
+bool nusr_renderbuffer_is_area_dirty(const nusr_renderbuffer_t *self,
+    int32_t xmin, int32_t ymin,
+    int32_t xmax, int32_t ymax
+)
+{
+    uint32_t tiles[4];
+    if (!area_tiles(self, xmin, ymin, xmax, ymax, tiles)) return false;
+    for (uint32_t ty = tiles[1]; ty < tiles[3]; ty++) {
+        for (uint32_t tx = tiles[0]; tx < tiles[2]; tx++) {
+            if (self->tile_dirty[ty * self->tile_count_x + tx]) return true;
+        }
+    }
+    return false;
+}
+uint32_t nusr_renderbuffer_get_dirty_tile_count(const nusr_renderbuffer_t *self)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < self->tile_count_x * self->tile_count_y; i++) {
+        count += self->tile_dirty[i];
+    }
+    return count;
+}
+float nusr_renderbuffer_depth_value(const nusr_renderbuffer_t *self, float z, float w, float near, float far)
+{
+    /* z is the normalized device depth, w the view depth, normalized and
+     * reversed values are affine in screen space so planes stay exact,
+     * vertices are clipped to the depth range and clamped against rounding */
+    switch (self->depth_format) {
+        case NUSR_DEPTH_FORMAT_FLOAT32_REVERSED:
+            return NU_MIN(NU_MAX(-(near * (far - w)) / (w * (far - near)), -1.0f), 0.0f);
+        case NUSR_DEPTH_FORMAT_UNORM24:
+            return NU_MIN(NU_MAX(z * 0.5f + 0.5f, 0.0f), 1.0f) * (float)NUSR_DEPTH_UNORM24_MAX;
+        case NUSR_DEPTH_FORMAT_UNORM16:
+            return NU_MIN(NU_MAX(z * 0.5f + 0.5f, 0.0f), 1.0f) * (float)NUSR_DEPTH_UNORM16_MAX;
+        default:
+            return NU_MIN(NU_MAX(w, near), far);
+    }
 }
\ No newline at end of file
@@ -3,12 +3,95 @@
 
 #include "framebuffer.h"
 
+/* size of the coarse depth blocks (in pixels) */
+#define NUSR_RENDERBUFFER_HIZ_SIZE 8
+
+/* size of the tiles with deferred color clears (in pixels) */
+#define NUSR_RENDERBUFFER_TILE_SIZE 64
+#define NUSR_RENDERBUFFER_CLEAR_COLOR 0x0
+
+/* largest width and height, clipped triangles must stay in the range of
+ * the fixed point rasterizer */
+#define NUSR_RENDERBUFFER_MAX_SIZE (1 << 16)
+
+/* multisampled renderbuffers keep 4 depth and color samples per pixel */
+#define NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT 4
+
+/* largest values of the normalized formats, used as clear values */
+#define NUSR_DEPTH_UNORM24_MAX 0xFFFFFF
+#define NUSR_DEPTH_UNORM16_MAX 0xFFFF
+
+/* smaller values are closer in every format */
+typedef enum {
+    NUSR_DEPTH_FORMAT_FLOAT32          = 0, /* view depth */
+    NUSR_DEPTH_FORMAT_FLOAT32_REVERSED = 1, /* 1 at near to 0 at far, stored negated */
+    NUSR_DEPTH_FORMAT_UNORM24          = 2, /* low 24 bits of 32 bits pixels */
+    NUSR_DEPTH_FORMAT_UNORM16          = 3
+} nusr_depth_format_t;
+
 typedef struct {
     nusr_framebuffer_t color_buffer;
+    /* samples are stored in planes of width * height pixels, colors are
+     * resolved in the color buffer */
+    uint32_t sample_count;
+    uint32_t sample_stride;
+    nusr_framebuffer_t sample_buffer;
+    /* 32 bits formats use the depth framebuffer, 16 bits ones depth16,
+     * one depth per sample */
+    nusr_depth_format_t depth_format;
     nusr_framebuffer_t depth_buffer;
+    uint16_t *depth16;
+    /* farthest depth per block, an upper bound when dirty */
+    uint32_t hiz_width;
+    uint32_t hiz_height;
+    float *hiz_max_depth;
+    bool *hiz_dirty;
+    /* tiles left untouched by geometry, cleared by the resolve */
+    uint32_t tile_count_x;
+    uint32_t tile_count_y;
+    bool *tile_clear_pending;
+    /* tiles whose content is out of date, others are kept between frames */
+    bool *tile_dirty;
 } nusr_renderbuffer_t;
 
-nu_result_t nusr_renderbuffer_create(nusr_renderbuffer_t *self, uint32_t width, uint32_t height);
+nu_result_t nusr_renderbuffer_create(nusr_renderbuffer_t *self,
+    uint32_t width, uint32_t height,
+    nusr_depth_format_t depth_format,
+    uint32_t sample_count
+);
 nu_result_t nusr_renderbuffer_destroy(nusr_renderbuffer_t *self);
+nu_result_t nusr_renderbuffer_clear_color_area(nusr_renderbuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    uint32_t color
+);
+nu_result_t nusr_renderbuffer_resolve_samples_area(nusr_renderbuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+);
+nu_result_t nusr_renderbuffer_clear_depth_area(nusr_renderbuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+);
+nu_result_t nusr_renderbuffer_clear_hiz_area(nusr_renderbuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    float depth
+);
+nu_result_t nusr_renderbuffer_defer_clear_area(nusr_renderbuffer_t *self,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+);
+nu_result_t nusr_renderbuffer_resolve(nusr_renderbuffer_t *self);
+nu_result_t nusr_renderbuffer_invalidate_area(nusr_renderbuffer_t *self,
+    int32_t xmin, int32_t ymin,
+    int32_t xmax, int32_t ymax
+);
+bool nusr_renderbuffer_is_area_dirty(const nusr_renderbuffer_t *self,
+    int32_t xmin, int32_t ymin,
+    int32_t xmax, int32_t ymax
+);
+uint32_t nusr_renderbuffer_get_dirty_tile_count(const nusr_renderbuffer_t *self);
+float nusr_renderbuffer_depth_value(const nusr_renderbuffer_t *self, float z, float w, float near, float far);
 
 #endif
\ No newline at end of file
@@ -48,6 +48,12 @@ nu_result_t nu_renderer_get_interface(nu_renderer_interface_t *interface)
     interface->staticmesh_create        = nusr_scene_staticmesh_create;
     interface->staticmesh_destroy       = nusr_scene_staticmesh_destroy;
     interface->staticmesh_set_transform = nusr_scene_staticmesh_set_transform;
+    interface->staticmesh_query_ray     = nusr_scene_staticmesh_query_ray;
+    interface->staticmesh_query_aabb    = nusr_scene_staticmesh_query_aabb;
+
+    interface->instancedmesh_create         = nusr_scene_instancedmesh_create;
+    interface->instancedmesh_destroy        = nusr_scene_instancedmesh_destroy;
+    interface->instancedmesh_set_transforms = nusr_scene_instancedmesh_set_transforms;
 
     interface->label_create       = nusr_gui_label_create;
     interface->label_destroy      = nusr_gui_label_destroy;
@@ -0,0 +1,114 @@
+#include "binning.h"
+
+#define DEFAULT_BIN_CAPACITY      64
+#define DEFAULT_TRIANGLE_CAPACITY 1024
+
+static void destroy_bins(nusr_binning_t *self)
+{
+    for (uint32_t i = 0; i < self->tile_count_x * self->tile_count_y; i++) {
+        nu_free(self->bins[i].triangles);
+    }
+    if (self->bins) {
+        nu_free(self->bins);
+        self->bins = NULL;
+    }
+}
+static void create_bins(nusr_binning_t *self, uint32_t width, uint32_t height)
+{
+    self->width = width;
+    self->height = height;
+    self->tile_count_x = (width + NUSR_BINNING_TILE_SIZE - 1) / NUSR_BINNING_TILE_SIZE;
+    self->tile_count_y = (height + NUSR_BINNING_TILE_SIZE - 1) / NUSR_BINNING_TILE_SIZE;
+
+    uint32_t tile_count = self->tile_count_x * self->tile_count_y;
+    self->bins = (nusr_bin_t*)nu_malloc(sizeof(nusr_bin_t) * tile_count);
+    for (uint32_t i = 0; i < tile_count; i++) {
+        self->bins[i].triangle_count = 0;
+        self->bins[i].triangle_capacity = DEFAULT_BIN_CAPACITY;
+        self->bins[i].triangles = (uint32_t*)nu_malloc(sizeof(uint32_t) * DEFAULT_BIN_CAPACITY);
+    }
+}
+
+nu_result_t nusr_binning_create(nusr_binning_t *self)
+{
+    self->width = 0;
+    self->height = 0;
+    self->tile_count_x = 0;
+    self->tile_count_y = 0;
+    self->bins = NULL;
+
+    self->triangle_count = 0;
+    self->triangle_capacity = DEFAULT_TRIANGLE_CAPACITY;
+    self->triangles = (nusr_triangle_t*)nu_malloc(sizeof(nusr_triangle_t) * DEFAULT_TRIANGLE_CAPACITY);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_binning_destroy(nusr_binning_t *self)
+{
+    destroy_bins(self);
+    nu_free(self->triangles);
+    self->triangles = NULL;
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_binning_reset(nusr_binning_t *self, uint32_t width, uint32_t height)
+{
+    /* recreate bins on resize */
+    if (width != self->width || height != self->height) {
+        destroy_bins(self);
+        create_bins(self, width, height);
+    }
+
+    /* empty bins */
+    for (uint32_t i = 0; i < self->tile_count_x * self->tile_count_y; i++) {
+        self->bins[i].triangle_count = 0;
+    }
+    self->triangle_count = 0;
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_binning_push_triangle(nusr_binning_t *self, const nusr_triangle_t *triangle)
+{
+    /* store triangle */
+    if (self->triangle_count >= self->triangle_capacity) {
+        self->triangle_capacity *= 2;
+        self->triangles = (nusr_triangle_t*)nu_realloc(self->triangles, sizeof(nusr_triangle_t) * self->triangle_capacity);
+    }
+    uint32_t id = self->triangle_count++;
+    self->triangles[id] = *triangle;
+
+    /* find overlapped tiles */
+    uint32_t txmin = triangle->xmin / NUSR_BINNING_TILE_SIZE;
+    uint32_t tymin = triangle->ymin / NUSR_BINNING_TILE_SIZE;
+    uint32_t txmax = (triangle->xmax - 1) / NUSR_BINNING_TILE_SIZE;
+    uint32_t tymax = (triangle->ymax - 1) / NUSR_BINNING_TILE_SIZE;
+
+    /* append triangle to bins */
+    for (uint32_t ty = tymin; ty <= tymax; ty++) {
+        for (uint32_t tx = txmin; tx <= txmax; tx++) {
+            nusr_bin_t *bin = &self->bins[ty * self->tile_count_x + tx];
+            if (bin->triangle_count >= bin->triangle_capacity) {
+                bin->triangle_capacity *= 2;
+                bin->triangles = (uint32_t*)nu_realloc(bin->triangles, sizeof(uint32_t) * bin->triangle_capacity);
+            }
+            bin->triangles[bin->triangle_count++] = id;
+        }
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_binning_get_tile_area(
+    const nusr_binning_t *self, uint32_t tile,
+    uint32_t *xmin, uint32_t *ymin,
+    uint32_t *xmax, uint32_t *ymax
+)
+{
+    uint32_t tx = tile % self->tile_count_x;
+    uint32_t ty = tile / self->tile_count_x;
+    *xmin = tx * NUSR_BINNING_TILE_SIZE;
+    *ymin = ty * NUSR_BINNING_TILE_SIZE;
+    *xmax = NU_MIN(*xmin + NUSR_BINNING_TILE_SIZE, self->width);
+    *ymax = NU_MIN(*ymin + NUSR_BINNING_TILE_SIZE, self->height);
+
+    return NU_SUCCESS;
+}
\ No newline at end of file
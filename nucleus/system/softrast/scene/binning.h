@@ -0,0 +1,36 @@
+#ifndef NUSR_SCENE_BINNING_H
+#define NUSR_SCENE_BINNING_H
+
+#include "raster.h"
+
+/* bins match the deferred clear tiles of the renderbuffer */
+#define NUSR_BINNING_TILE_SIZE NUSR_RENDERBUFFER_TILE_SIZE
+
+typedef struct {
+    uint32_t *triangles;
+    uint32_t triangle_count;
+    uint32_t triangle_capacity;
+} nusr_bin_t;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t tile_count_x;
+    uint32_t tile_count_y;
+    nusr_bin_t *bins;
+    nusr_triangle_t *triangles;
+    uint32_t triangle_count;
+    uint32_t triangle_capacity;
+} nusr_binning_t;
+
+nu_result_t nusr_binning_create(nusr_binning_t *self);
+nu_result_t nusr_binning_destroy(nusr_binning_t *self);
+nu_result_t nusr_binning_reset(nusr_binning_t *self, uint32_t width, uint32_t height);
+nu_result_t nusr_binning_push_triangle(nusr_binning_t *self, const nusr_triangle_t *triangle);
+nu_result_t nusr_binning_get_tile_area(
+    const nusr_binning_t *self, uint32_t tile,
+    uint32_t *xmin, uint32_t *ymin,
+    uint32_t *xmax, uint32_t *ymax
+);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,427 @@
+#include "bvh.h"
+
+#include <math.h>
+
+#define DEFAULT_NODE_CAPACITY   64
+#define DEFAULT_STACK_CAPACITY  64
+#define DEFAULT_RESULT_CAPACITY 64
+/* stack entries of subtrees known to be inside the frustum */
+#define INSIDE_BIT 0x80000000
+
+typedef enum {
+    CULL_OUTSIDE,
+    CULL_INSIDE,
+    CULL_PARTIAL
+} nusr_bvh_cull_t;
+
+static void aabb_union(const nusr_aabb_t *a, const nusr_aabb_t *b, nusr_aabb_t *dest)
+{
+    for (uint32_t c = 0; c < 3; c++) {
+        dest->min[c] = NU_MIN(a->min[c], b->min[c]);
+        dest->max[c] = NU_MAX(a->max[c], b->max[c]);
+    }
+}
+static float aabb_area(const nusr_aabb_t *box)
+{
+    /* half the surface area, costs are only compared */
+    float x = box->max[0] - box->min[0];
+    float y = box->max[1] - box->min[1];
+    float z = box->max[2] - box->min[2];
+    return x * y + y * z + z * x;
+}
+static bool aabb_overlap(const nusr_aabb_t *a, const nusr_aabb_t *b)
+{
+    for (uint32_t c = 0; c < 3; c++) {
+        if (a->max[c] < b->min[c] || b->max[c] < a->min[c]) return false;
+    }
+    return true;
+}
+static nusr_bvh_cull_t aabb_frustum(const nu_vec4_t planes[6], const nusr_aabb_t *box)
+{
+    /* center and extents against each plane, same as the mesh culling */
+    const nu_vec3_t center = {
+        (box->min[0] + box->max[0]) * 0.5f,
+        (box->min[1] + box->max[1]) * 0.5f,
+        (box->min[2] + box->max[2]) * 0.5f
+    };
+    const nu_vec3_t extents = {
+        (box->max[0] - box->min[0]) * 0.5f,
+        (box->max[1] - box->min[1]) * 0.5f,
+        (box->max[2] - box->min[2]) * 0.5f
+    };
+    nusr_bvh_cull_t result = CULL_INSIDE;
+    for (uint32_t p = 0; p < 6; p++) {
+        float d = planes[p][0] * center[0] + planes[p][1] * center[1] + planes[p][2] * center[2] + planes[p][3];
+        float r = fabsf(planes[p][0]) * extents[0]
+            + fabsf(planes[p][1]) * extents[1]
+            + fabsf(planes[p][2]) * extents[2];
+        if (d + r < 0.0f) return CULL_OUTSIDE;
+        if (d - r < 0.0f) result = CULL_PARTIAL;
+    }
+    return result;
+}
+static bool aabb_ray(const nusr_aabb_t *box, const nu_vec3_t origin, const nu_vec3_t direction, const nu_vec3_t inv_direction, float max_distance, float *entry)
+{
+    /* slab test, the entry distance is 0 when the origin is inside */
+    float tmin = 0.0f;
+    float tmax = max_distance;
+    for (uint32_t c = 0; c < 3; c++) {
+        /* parallel rays are inside the slab for any distance or never, the
+         * infinite inverse would give nan at the slab planes */
+        if (direction[c] == 0.0f) {
+            if (origin[c] < box->min[c] || origin[c] > box->max[c]) return false;
+            continue;
+        }
+        float t0 = (box->min[c] - origin[c]) * inv_direction[c];
+        float t1 = (box->max[c] - origin[c]) * inv_direction[c];
+        tmin = NU_MAX(tmin, NU_MIN(t0, t1));
+        tmax = NU_MIN(tmax, NU_MAX(t0, t1));
+    }
+    *entry = tmin;
+    return tmin <= tmax;
+}
+
+static bool is_leaf(const nusr_bvh_node_t *node)
+{
+    return node->children[0] == NUSR_BVH_NULL_NODE;
+}
+static void chain_free_nodes(nusr_bvh_t *self, uint32_t first)
+{
+    for (uint32_t i = first; i < self->node_capacity; i++) {
+        self->nodes[i].parent = (i + 1 < self->node_capacity) ? i + 1 : NUSR_BVH_NULL_NODE;
+        self->nodes[i].height = -1;
+    }
+    self->free_node = first;
+}
+static uint32_t allocate_node(nusr_bvh_t *self)
+{
+    /* grow the pool, node pointers are invalidated */
+    if (self->free_node == NUSR_BVH_NULL_NODE) {
+        uint32_t first = self->node_capacity;
+        self->node_capacity *= 2;
+        self->nodes = (nusr_bvh_node_t*)nu_realloc(self->nodes, sizeof(nusr_bvh_node_t) * self->node_capacity);
+        chain_free_nodes(self, first);
+    }
+
+    uint32_t index = self->free_node;
+    nusr_bvh_node_t *node = &self->nodes[index];
+    self->free_node = node->parent;
+    node->parent = NUSR_BVH_NULL_NODE;
+    node->children[0] = NUSR_BVH_NULL_NODE;
+    node->children[1] = NUSR_BVH_NULL_NODE;
+    node->value = 0;
+    node->height = 0;
+    return index;
+}
+static void free_node(nusr_bvh_t *self, uint32_t index)
+{
+    self->nodes[index].parent = self->free_node;
+    self->nodes[index].height = -1;
+    self->free_node = index;
+}
+static void replace_child(nusr_bvh_t *self, uint32_t parent, uint32_t old_child, uint32_t new_child)
+{
+    if (parent == NUSR_BVH_NULL_NODE) {
+        self->root = new_child;
+    } else if (self->nodes[parent].children[0] == old_child) {
+        self->nodes[parent].children[0] = new_child;
+    } else {
+        self->nodes[parent].children[1] = new_child;
+    }
+}
+static uint32_t rotate(nusr_bvh_t *self, uint32_t a, uint32_t side)
+{
+    /* the taller child x of a takes its place, a keeps the shortest child
+     * of x and x keeps the tallest one */
+    nusr_bvh_node_t *nodes = self->nodes;
+    const uint32_t x = nodes[a].children[side];
+    const uint32_t other = nodes[a].children[1 - side];
+    uint32_t f = nodes[x].children[0];
+    uint32_t g = nodes[x].children[1];
+    if (nodes[f].height < nodes[g].height) {
+        uint32_t tmp = f;
+        f = g;
+        g = tmp;
+    }
+
+    nodes[x].parent = nodes[a].parent;
+    replace_child(self, nodes[x].parent, a, x);
+    nodes[x].children[0] = a;
+    nodes[x].children[1] = f;
+    nodes[a].parent = x;
+    nodes[a].children[side] = g;
+    nodes[g].parent = a;
+
+    aabb_union(&nodes[other].box, &nodes[g].box, &nodes[a].box);
+    aabb_union(&nodes[a].box, &nodes[f].box, &nodes[x].box);
+    nodes[a].height = 1 + NU_MAX(nodes[other].height, nodes[g].height);
+    nodes[x].height = 1 + NU_MAX(nodes[a].height, nodes[f].height);
+    return x;
+}
+static uint32_t balance(nusr_bvh_t *self, uint32_t a)
+{
+    /* rotate when the children heights differ by more than one */
+    const nusr_bvh_node_t *node = &self->nodes[a];
+    if (is_leaf(node) || node->height < 2) return a;
+    int32_t difference = self->nodes[node->children[1]].height - self->nodes[node->children[0]].height;
+    if (difference > 1) return rotate(self, a, 1);
+    if (difference < -1) return rotate(self, a, 0);
+    return a;
+}
+static void refit(nusr_bvh_t *self, uint32_t index)
+{
+    /* balance and refit every ancestor up to the root */
+    while (index != NUSR_BVH_NULL_NODE) {
+        index = balance(self, index);
+        nusr_bvh_node_t *node = &self->nodes[index];
+        const nusr_bvh_node_t *c0 = &self->nodes[node->children[0]];
+        const nusr_bvh_node_t *c1 = &self->nodes[node->children[1]];
+        node->height = 1 + NU_MAX(c0->height, c1->height);
+        aabb_union(&c0->box, &c1->box, &node->box);
+        index = node->parent;
+    }
+}
+static void insert_leaf(nusr_bvh_t *self, uint32_t leaf)
+{
+    if (self->root == NUSR_BVH_NULL_NODE) {
+        self->root = leaf;
+        self->nodes[leaf].parent = NUSR_BVH_NULL_NODE;
+        return;
+    }
+
+    /* the new parent is allocated before taking node pointers */
+    const uint32_t parent = allocate_node(self);
+    nusr_bvh_node_t *nodes = self->nodes;
+    const nusr_aabb_t *box = &nodes[leaf].box;
+
+    /* descend to the sibling with the lowest surface area cost, a new
+     * parent costs its area and ancestors grow by the inherited cost */
+    uint32_t sibling = self->root;
+    while (!is_leaf(&nodes[sibling])) {
+        const nusr_bvh_node_t *node = &nodes[sibling];
+        nusr_aabb_t combined;
+        aabb_union(&node->box, box, &combined);
+        const float combined_area = aabb_area(&combined);
+        const float cost = 2.0f * combined_area;
+        const float inheritance = 2.0f * (combined_area - aabb_area(&node->box));
+
+        float child_cost[2];
+        for (uint32_t k = 0; k < 2; k++) {
+            const nusr_bvh_node_t *child = &nodes[node->children[k]];
+            aabb_union(&child->box, box, &combined);
+            child_cost[k] = aabb_area(&combined) + inheritance;
+            if (!is_leaf(child)) child_cost[k] -= aabb_area(&child->box);
+        }
+        if (cost < child_cost[0] && cost < child_cost[1]) break;
+        sibling = node->children[child_cost[1] < child_cost[0]];
+    }
+
+    /* link the sibling and the leaf under the new parent */
+    const uint32_t old_parent = nodes[sibling].parent;
+    nodes[parent].parent = old_parent;
+    nodes[parent].children[0] = sibling;
+    nodes[parent].children[1] = leaf;
+    nodes[parent].height = nodes[sibling].height + 1;
+    aabb_union(&nodes[sibling].box, box, &nodes[parent].box);
+    replace_child(self, old_parent, sibling, parent);
+    nodes[sibling].parent = parent;
+    nodes[leaf].parent = parent;
+
+    refit(self, parent);
+}
+static void remove_leaf(nusr_bvh_t *self, uint32_t leaf)
+{
+    if (leaf == self->root) {
+        self->root = NUSR_BVH_NULL_NODE;
+        return;
+    }
+
+    /* the sibling takes the place of the parent */
+    nusr_bvh_node_t *nodes = self->nodes;
+    const uint32_t parent = nodes[leaf].parent;
+    const uint32_t grand_parent = nodes[parent].parent;
+    const uint32_t sibling = (nodes[parent].children[0] == leaf) ? nodes[parent].children[1] : nodes[parent].children[0];
+    replace_child(self, grand_parent, parent, sibling);
+    nodes[sibling].parent = grand_parent;
+    free_node(self, parent);
+
+    refit(self, grand_parent);
+}
+
+static void push_stack(nusr_bvh_t *self, uint32_t *count, uint32_t entry)
+{
+    if (*count >= self->stack_capacity) {
+        self->stack_capacity *= 2;
+        self->stack = (uint32_t*)nu_realloc(self->stack, sizeof(uint32_t) * self->stack_capacity);
+    }
+    self->stack[(*count)++] = entry;
+}
+static void push_result(nusr_bvh_t *self, uint32_t value, float distance)
+{
+    if (self->result_count >= self->result_capacity) {
+        self->result_capacity *= 2;
+        self->results = (uint32_t*)nu_realloc(self->results, sizeof(uint32_t) * self->result_capacity);
+        self->distances = (float*)nu_realloc(self->distances, sizeof(float) * self->result_capacity);
+    }
+    self->results[self->result_count] = value;
+    self->distances[self->result_count] = distance;
+    self->result_count++;
+}
+
+void nusr_aabb_transform(const nusr_aabb_t *box, const nu_mat4_t transform, nusr_aabb_t *dest)
+{
+    /* transformed center, extents are the absolute matrix applied to the
+     * local extents */
+    nu_vec4_t center = {
+        (box->min[0] + box->max[0]) * 0.5f,
+        (box->min[1] + box->max[1]) * 0.5f,
+        (box->min[2] + box->max[2]) * 0.5f,
+        1.0f
+    };
+    const nu_vec3_t extents = {
+        (box->max[0] - box->min[0]) * 0.5f,
+        (box->max[1] - box->min[1]) * 0.5f,
+        (box->max[2] - box->min[2]) * 0.5f
+    };
+    nu_vec4_t world_center;
+    nu_mat4_mulv(transform, center, world_center);
+    for (uint32_t i = 0; i < 3; i++) {
+        float e = fabsf(transform[0][i]) * extents[0]
+            + fabsf(transform[1][i]) * extents[1]
+            + fabsf(transform[2][i]) * extents[2];
+        dest->min[i] = world_center[i] - e;
+        dest->max[i] = world_center[i] + e;
+    }
+}
+
+nu_result_t nusr_bvh_create(nusr_bvh_t *self)
+{
+    self->root = NUSR_BVH_NULL_NODE;
+    self->node_capacity = DEFAULT_NODE_CAPACITY;
+    self->nodes = (nusr_bvh_node_t*)nu_malloc(sizeof(nusr_bvh_node_t) * DEFAULT_NODE_CAPACITY);
+    chain_free_nodes(self, 0);
+
+    self->stack_capacity = DEFAULT_STACK_CAPACITY;
+    self->stack = (uint32_t*)nu_malloc(sizeof(uint32_t) * DEFAULT_STACK_CAPACITY);
+
+    self->result_count = 0;
+    self->result_capacity = DEFAULT_RESULT_CAPACITY;
+    self->results = (uint32_t*)nu_malloc(sizeof(uint32_t) * DEFAULT_RESULT_CAPACITY);
+    self->distances = (float*)nu_malloc(sizeof(float) * DEFAULT_RESULT_CAPACITY);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_bvh_destroy(nusr_bvh_t *self)
+{
+    nu_free(self->nodes);
+    nu_free(self->stack);
+    nu_free(self->results);
+    nu_free(self->distances);
+
+    return NU_SUCCESS;
+}
+uint32_t nusr_bvh_insert(nusr_bvh_t *self, const nusr_aabb_t *box, uint32_t value)
+{
+    uint32_t leaf = allocate_node(self);
+    self->nodes[leaf].box = *box;
+    self->nodes[leaf].value = value;
+    insert_leaf(self, leaf);
+    return leaf;
+}
+nu_result_t nusr_bvh_remove(nusr_bvh_t *self, uint32_t leaf)
+{
+    if (leaf >= self->node_capacity || self->nodes[leaf].height != 0) return NU_FAILURE;
+
+    remove_leaf(self, leaf);
+    free_node(self, leaf);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_bvh_update(nusr_bvh_t *self, uint32_t leaf, const nusr_aabb_t *box)
+{
+    if (leaf >= self->node_capacity || self->nodes[leaf].height != 0) return NU_FAILURE;
+
+    /* ancestors are refitted in place, leaves moved away from their
+     * previous box are reinserted so the hierarchy stays tight */
+    if (!aabb_overlap(&self->nodes[leaf].box, box)) {
+        remove_leaf(self, leaf);
+        self->nodes[leaf].box = *box;
+        insert_leaf(self, leaf);
+    } else {
+        self->nodes[leaf].box = *box;
+        refit(self, self->nodes[leaf].parent);
+    }
+
+    return NU_SUCCESS;
+}
+
+nu_result_t nusr_bvh_query_frustum(nusr_bvh_t *self, const nu_vec4_t planes[6])
+{
+    self->result_count = 0;
+    if (self->root == NUSR_BVH_NULL_NODE) return NU_SUCCESS;
+
+    /* subtrees inside the frustum are collected without plane tests */
+    uint32_t count = 0;
+    push_stack(self, &count, self->root);
+    while (count) {
+        const uint32_t entry = self->stack[--count];
+        const nusr_bvh_node_t *node = &self->nodes[entry & ~INSIDE_BIT];
+        uint32_t inside = entry & INSIDE_BIT;
+        if (!inside) {
+            nusr_bvh_cull_t cull = aabb_frustum(planes, &node->box);
+            if (cull == CULL_OUTSIDE) continue;
+            if (cull == CULL_INSIDE) inside = INSIDE_BIT;
+        }
+        if (is_leaf(node)) {
+            push_result(self, node->value, 0.0f);
+            continue;
+        }
+        push_stack(self, &count, node->children[1] | inside);
+        push_stack(self, &count, node->children[0] | inside);
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_bvh_query_aabb(nusr_bvh_t *self, const nusr_aabb_t *box)
+{
+    self->result_count = 0;
+    if (self->root == NUSR_BVH_NULL_NODE) return NU_SUCCESS;
+
+    uint32_t count = 0;
+    push_stack(self, &count, self->root);
+    while (count) {
+        const nusr_bvh_node_t *node = &self->nodes[self->stack[--count]];
+        if (!aabb_overlap(&node->box, box)) continue;
+        if (is_leaf(node)) {
+            push_result(self, node->value, 0.0f);
+            continue;
+        }
+        push_stack(self, &count, node->children[1]);
+        push_stack(self, &count, node->children[0]);
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_bvh_query_ray(nusr_bvh_t *self, const nu_vec3_t origin, const nu_vec3_t direction, float max_distance)
+{
+    self->result_count = 0;
+    if (self->root == NUSR_BVH_NULL_NODE) return NU_SUCCESS;
+
+    /* leaves are returned with the ray parameter where the ray enters them */
+    const nu_vec3_t inv_direction = {1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2]};
+    uint32_t count = 0;
+    push_stack(self, &count, self->root);
+    while (count) {
+        const nusr_bvh_node_t *node = &self->nodes[self->stack[--count]];
+        float entry;
+        if (!aabb_ray(&node->box, origin, direction, inv_direction, max_distance, &entry)) continue;
+        if (is_leaf(node)) {
+            push_result(self, node->value, entry);
+            continue;
+        }
+        push_stack(self, &count, node->children[1]);
+        push_stack(self, &count, node->children[0]);
+    }
+
+    return NU_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef NUSR_SCENE_BVH_H
+#define NUSR_SCENE_BVH_H
+
+#include "../module/interface.h"
+
+/* index of missing nodes (no parent, no children, empty tree) */
+#define NUSR_BVH_NULL_NODE 0xFFFFFFFF
+
+typedef struct {
+    nu_vec3_t min;
+    nu_vec3_t max;
+} nusr_aabb_t;
+
+typedef struct {
+    nusr_aabb_t box;
+    /* next free node when the node is not used */
+    uint32_t parent;
+    /* leaves have no children and keep a user value */
+    uint32_t children[2];
+    uint32_t value;
+    /* height of the subtree, leaves are 0 */
+    int32_t height;
+} nusr_bvh_node_t;
+
+typedef struct {
+    nusr_bvh_node_t *nodes;
+    uint32_t node_capacity;
+    uint32_t root;
+    uint32_t free_node;
+    /* traversal stack */
+    uint32_t *stack;
+    uint32_t stack_capacity;
+    /* values of the last query, ray queries also keep the entry distances */
+    uint32_t *results;
+    float *distances;
+    uint32_t result_count;
+    uint32_t result_capacity;
+} nusr_bvh_t;
+
+void nusr_aabb_transform(const nusr_aabb_t *box, const nu_mat4_t transform, nusr_aabb_t *dest);
+
+nu_result_t nusr_bvh_create(nusr_bvh_t *self);
+nu_result_t nusr_bvh_destroy(nusr_bvh_t *self);
+uint32_t nusr_bvh_insert(nusr_bvh_t *self, const nusr_aabb_t *box, uint32_t value);
+nu_result_t nusr_bvh_remove(nusr_bvh_t *self, uint32_t leaf);
+nu_result_t nusr_bvh_update(nusr_bvh_t *self, uint32_t leaf, const nusr_aabb_t *box);
+
+/* queries fill results, frustum planes are inside positive */
+nu_result_t nusr_bvh_query_frustum(nusr_bvh_t *self, const nu_vec4_t planes[6]);
+nu_result_t nusr_bvh_query_aabb(nusr_bvh_t *self, const nusr_aabb_t *box);
+nu_result_t nusr_bvh_query_ray(nusr_bvh_t *self, const nu_vec3_t origin, const nu_vec3_t direction, float max_distance);
+
+#endif
\ No newline at end of file
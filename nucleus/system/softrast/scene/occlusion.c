@@ -0,0 +1,168 @@
+#include "occlusion.h"
+
+#include <float.h>
+#include <math.h>
+
+/* vertices closer than this are not rasterized as occluders */
+#define MIN_OCCLUDER_W 0.0001f
+
+static void clip_to_screen(const nu_vec4_t clip, nu_vec4_t screen)
+{
+    /* keep view depth in w */
+    float inv_w = 1.0f / clip[3];
+    screen[0] = (clip[0] * inv_w + 1.0f) * 0.5f * NUSR_OCCLUSION_WIDTH;
+    screen[1] = (clip[1] * inv_w + 1.0f) * 0.5f * NUSR_OCCLUSION_HEIGHT;
+    screen[2] = clip[2] * inv_w;
+    screen[3] = clip[3];
+}
+static void rasterize_triangle(nusr_occlusion_t *self, const nu_vec4_t v0, const nu_vec4_t v1, const nu_vec4_t v2)
+{
+    /* same orientation as the main rasterizer, back faces are culled */
+    float area = (v2[0] - v0[0]) * (v1[1] - v0[1]) - (v2[1] - v0[1]) * (v1[0] - v0[0]);
+    if (area <= 0.0f) return;
+    float area_inv = 1.0f / area;
+
+    /* bounding box */
+    int32_t xmin = (int32_t)floorf(NU_MAX(0.0f, NU_MIN(v0[0], NU_MIN(v1[0], v2[0]))));
+    int32_t ymin = (int32_t)floorf(NU_MAX(0.0f, NU_MIN(v0[1], NU_MIN(v1[1], v2[1]))));
+    int32_t xmax = (int32_t)ceilf(NU_MIN((float)NUSR_OCCLUSION_WIDTH, NU_MAX(v0[0], NU_MAX(v1[0], v2[0]))));
+    int32_t ymax = (int32_t)ceilf(NU_MIN((float)NUSR_OCCLUSION_HEIGHT, NU_MAX(v0[1], NU_MAX(v1[1], v2[1]))));
+    if (xmin >= xmax || ymin >= ymax) return;
+
+    /* edges (e = a * (x - ox) + b * (y - oy)) */
+    const float *o[3] = {v1, v2, v0};
+    const float *d[3] = {v2, v0, v1};
+    float a[3], b[3], margin[3];
+    for (uint32_t k = 0; k < 3; k++) {
+        a[k] = d[k][1] - o[k][1];
+        b[k] = o[k][0] - d[k][0];
+        /* inner conservative test, the whole pixel must be covered */
+        margin[k] = (fabsf(a[k]) + fabsf(b[k])) * 0.5f;
+    }
+
+    /* depth plane, evaluated at the farthest pixel corner */
+    float d0 = v0[3] - v2[3];
+    float d1 = v1[3] - v2[3];
+    float zx = (a[0] * d0 + a[1] * d1) * area_inv;
+    float zy = (b[0] * d0 + b[1] * d1) * area_inv;
+    float zmargin = (fabsf(zx) + fabsf(zy)) * 0.5f;
+    float zmax = NU_MAX(v0[3], NU_MAX(v1[3], v2[3]));
+
+    for (int32_t y = ymin; y < ymax; y++) {
+        for (int32_t x = xmin; x < xmax; x++) {
+            float sx = x + 0.5f;
+            float sy = y + 0.5f;
+            bool inside = true;
+            for (uint32_t k = 0; k < 3; k++) {
+                inside &= (a[k] * (sx - o[k][0]) + b[k] * (sy - o[k][1])) > margin[k];
+            }
+            if (!inside) continue;
+
+            float depth = v0[3] + zx * (sx - v0[0]) + zy * (sy - v0[1]) + zmargin;
+            depth = NU_MIN(depth, zmax);
+            float *stored = &self->depth[y * NUSR_OCCLUSION_WIDTH + x];
+            *stored = NU_MIN(*stored, depth);
+        }
+    }
+}
+
+nu_result_t nusr_occlusion_create(nusr_occlusion_t *self)
+{
+    self->depth = (float*)nu_malloc(sizeof(float) * NUSR_OCCLUSION_WIDTH * NUSR_OCCLUSION_HEIGHT);
+    nusr_occlusion_reset(self);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_occlusion_destroy(nusr_occlusion_t *self)
+{
+    nu_free(self->depth);
+    self->depth = NULL;
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_occlusion_reset(nusr_occlusion_t *self)
+{
+    for (uint32_t i = 0; i < NUSR_OCCLUSION_WIDTH * NUSR_OCCLUSION_HEIGHT; i++) {
+        self->depth[i] = FLT_MAX;
+    }
+    self->occluded_count = 0;
+    self->visible_count = 0;
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_occlusion_rasterize_mesh(nusr_occlusion_t *self, const nusr_mesh_t *mesh, const nusr_vertex_buffer_t *vertices)
+{
+    /* vertices are given in clip space */
+    for (uint32_t ii = 0; ii < mesh->index_count; ii += 3) {
+        const uint32_t *triangle_indices = mesh->indices + ii;
+
+        /* fully outside one plane */
+        if (vertices->outcodes[triangle_indices[0]]
+            & vertices->outcodes[triangle_indices[1]]
+            & vertices->outcodes[triangle_indices[2]]) continue;
+
+        nu_vec4_t v[3];
+        bool near = false;
+        for (uint32_t i = 0; i < 3; i++) {
+            nusr_vertex_buffer_get(vertices, triangle_indices[i], v[i]);
+            near |= v[i][3] < MIN_OCCLUDER_W;
+        }
+
+        /* dropping an occluder triangle is always conservative */
+        if (near) continue;
+
+        clip_to_screen(v[0], v[0]);
+        clip_to_screen(v[1], v[1]);
+        clip_to_screen(v[2], v[2]);
+        rasterize_triangle(self, v[0], v[1], v[2]);
+    }
+
+    return NU_SUCCESS;
+}
+bool nusr_occlusion_test_mesh(nusr_occlusion_t *self, const nusr_mesh_t *mesh, const nu_mat4_t mvp)
+{
+    /* project the AABB corners */
+    float xmin = FLT_MAX, ymin = FLT_MAX, zmin = FLT_MAX;
+    float xmax = -FLT_MAX, ymax = -FLT_MAX;
+    for (uint32_t i = 0; i < 8; i++) {
+        nu_vec4_t corner = {
+            (i & 1) ? mesh->xmax : mesh->xmin,
+            (i & 2) ? mesh->ymax : mesh->ymin,
+            (i & 4) ? mesh->zmax : mesh->zmin,
+            1.0f
+        };
+        nu_vec4_t clip;
+        nu_mat4_mulv(mvp, corner, clip);
+
+        /* the box crosses the camera plane */
+        if (clip[3] < MIN_OCCLUDER_W) {
+            self->visible_count++;
+            return true;
+        }
+
+        nu_vec4_t screen;
+        clip_to_screen(clip, screen);
+        xmin = NU_MIN(xmin, screen[0]);
+        ymin = NU_MIN(ymin, screen[1]);
+        xmax = NU_MAX(xmax, screen[0]);
+        ymax = NU_MAX(ymax, screen[1]);
+        zmin = NU_MIN(zmin, screen[3]);
+    }
+
+    /* test the screen rectangle against the occluder depth */
+    int32_t x0 = (int32_t)floorf(NU_MAX(xmin, 0.0f));
+    int32_t y0 = (int32_t)floorf(NU_MAX(ymin, 0.0f));
+    int32_t x1 = (int32_t)ceilf(NU_MIN(xmax, (float)NUSR_OCCLUSION_WIDTH));
+    int32_t y1 = (int32_t)ceilf(NU_MIN(ymax, (float)NUSR_OCCLUSION_HEIGHT));
+    for (int32_t y = y0; y < y1; y++) {
+        for (int32_t x = x0; x < x1; x++) {
+            if (self->depth[y * NUSR_OCCLUSION_WIDTH + x] >= zmin) {
+                self->visible_count++;
+                return true;
+            }
+        }
+    }
+
+    self->occluded_count++;
+    return false;
+}
\ No newline at end of file
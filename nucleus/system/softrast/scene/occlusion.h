@@ -0,0 +1,22 @@
+#ifndef NUSR_SCENE_OCCLUSION_H
+#define NUSR_SCENE_OCCLUSION_H
+
+#include "vertex.h"
+
+#define NUSR_OCCLUSION_WIDTH  256
+#define NUSR_OCCLUSION_HEIGHT 128
+
+typedef struct {
+    /* farthest occluder depth per pixel (view depth) */
+    float *depth;
+    uint32_t occluded_count;
+    uint32_t visible_count;
+} nusr_occlusion_t;
+
+nu_result_t nusr_occlusion_create(nusr_occlusion_t *self);
+nu_result_t nusr_occlusion_destroy(nusr_occlusion_t *self);
+nu_result_t nusr_occlusion_reset(nusr_occlusion_t *self);
+nu_result_t nusr_occlusion_rasterize_mesh(nusr_occlusion_t *self, const nusr_mesh_t *mesh, const nusr_vertex_buffer_t *vertices);
+bool nusr_occlusion_test_mesh(nusr_occlusion_t *self, const nusr_mesh_t *mesh, const nu_mat4_t mvp);
+
+#endif
\ No newline at end of file
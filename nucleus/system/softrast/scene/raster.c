@@ -0,0 +1,1371 @@
+#include "raster.h"
+
+#include <math.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define NUSR_RASTER_AVX2
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+    #define NUSR_RASTER_SSE2
+#endif
+
+#if defined(NUSR_RASTER_AVX2)
+    /* 8x8 blocks, one 8 lanes vector per row */
+    #define BLOCK_SIZE 8
+    typedef __m256 vfloat_t;
+    typedef __m256i vint_t;
+    #define vf_set1(a)         _mm256_set1_ps(a)
+    #define vf_zero()          _mm256_setzero_ps()
+    #define vf_ones()          _mm256_castsi256_ps(_mm256_set1_epi32(-1))
+    #define vf_lanes()         _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)
+    #define vf_add(a, b)       _mm256_add_ps(a, b)
+    #define vf_sub(a, b)       _mm256_sub_ps(a, b)
+    #define vf_mul(a, b)       _mm256_mul_ps(a, b)
+    #define vf_div(a, b)       _mm256_div_ps(a, b)
+    #define vf_min(a, b)       _mm256_min_ps(a, b)
+    #define vf_max(a, b)       _mm256_max_ps(a, b)
+    #define vf_and(a, b)       _mm256_and_ps(a, b)
+    #define vf_or(a, b)        _mm256_or_ps(a, b)
+    #define vf_gt(a, b)        _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+    #define vf_lt(a, b)        _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+    #define vf_eq(a, b)        _mm256_cmp_ps(a, b, _CMP_EQ_OQ)
+    #define vf_select(m, a, b) _mm256_blendv_ps(b, a, m)
+    #define vf_movemask(a)     _mm256_movemask_ps(a)
+    #define vf_loadu(p)        _mm256_loadu_ps((const float*)(p))
+    #define vf_storeu(p, a)    _mm256_storeu_ps((float*)(p), a)
+    #define vf_to_int(a)       _mm256_cvttps_epi32(a)
+    #define vf_from_int(a)     _mm256_cvtepi32_ps(a)
+    #define vf_from_bits(a)    _mm256_castsi256_ps(a)
+    #define vf_as_bits(a)      _mm256_castps_si256(a)
+    #define vi_set1(a)         _mm256_set1_epi32(a)
+    #define vi_ramp(a)         _mm256_setr_epi32(0, (a), 2 * (a), 3 * (a), 4 * (a), 5 * (a), 6 * (a), 7 * (a))
+    #define vi_add(a, b)       _mm256_add_epi32(a, b)
+    #define vi_mul(a, b)       _mm256_mullo_epi32(a, b)
+    #define vi_and(a, b)       _mm256_and_si256(a, b)
+    #define vi_or(a, b)        _mm256_or_si256(a, b)
+    #define vi_shl(a, n)       _mm256_slli_epi32(a, n)
+    #define vi_sll(a, n)       _mm256_sll_epi32(a, _mm_cvtsi32_si128(n))
+    #define vi_srl(a, n)       _mm256_srl_epi32(a, _mm_cvtsi32_si128(n))
+    #define vi_gt(a, b)        _mm256_cmpgt_epi32(a, b)
+    #define vi_eq(a, b)        _mm256_cmpeq_epi32(a, b)
+    #define vi_sub(a, b)       _mm256_sub_epi32(a, b)
+    #define vi_add16(a, b)     _mm256_add_epi16(a, b)
+    #define vi_sub16(a, b)     _mm256_sub_epi16(a, b)
+    #define vi_mul16(a, b)     _mm256_mullo_epi16(a, b)
+    #define vi_srl16(a, n)     _mm256_srli_epi16(a, n)
+    #define vi_unpacklo8(a, b)  _mm256_unpacklo_epi8(a, b)
+    #define vi_unpackhi8(a, b)  _mm256_unpackhi_epi8(a, b)
+    #define vi_unpacklo16(a, b) _mm256_unpacklo_epi16(a, b)
+    #define vi_unpacklo32(a, b) _mm256_unpacklo_epi32(a, b)
+    #define vi_unpackhi32(a, b) _mm256_unpackhi_epi32(a, b)
+    #define vi_packs32(a, b)    _mm256_packs_epi32(a, b)
+    #define vi_packus16(a, b)   _mm256_packus_epi16(a, b)
+#elif defined(NUSR_RASTER_SSE2)
+    /* 4x4 blocks, one 4 lanes vector per row */
+    #define BLOCK_SIZE 4
+    typedef __m128 vfloat_t;
+    typedef __m128i vint_t;
+    #define vf_set1(a)         _mm_set1_ps(a)
+    #define vf_zero()          _mm_setzero_ps()
+    #define vf_ones()          _mm_castsi128_ps(_mm_set1_epi32(-1))
+    #define vf_lanes()         _mm_setr_ps(0, 1, 2, 3)
+    #define vf_add(a, b)       _mm_add_ps(a, b)
+    #define vf_sub(a, b)       _mm_sub_ps(a, b)
+    #define vf_mul(a, b)       _mm_mul_ps(a, b)
+    #define vf_div(a, b)       _mm_div_ps(a, b)
+    #define vf_min(a, b)       _mm_min_ps(a, b)
+    #define vf_max(a, b)       _mm_max_ps(a, b)
+    #define vf_and(a, b)       _mm_and_ps(a, b)
+    #define vf_or(a, b)        _mm_or_ps(a, b)
+    #define vf_gt(a, b)        _mm_cmpgt_ps(a, b)
+    #define vf_lt(a, b)        _mm_cmplt_ps(a, b)
+    #define vf_eq(a, b)        _mm_cmpeq_ps(a, b)
+    #define vf_select(m, a, b) _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+    #define vf_movemask(a)     _mm_movemask_ps(a)
+    #define vf_loadu(p)        _mm_loadu_ps((const float*)(p))
+    #define vf_storeu(p, a)    _mm_storeu_ps((float*)(p), a)
+    #define vf_to_int(a)       _mm_cvttps_epi32(a)
+    #define vf_from_int(a)     _mm_cvtepi32_ps(a)
+    #define vf_from_bits(a)    _mm_castsi128_ps(a)
+    #define vf_as_bits(a)      _mm_castps_si128(a)
+    #define vi_set1(a)         _mm_set1_epi32(a)
+    #define vi_ramp(a)         _mm_setr_epi32(0, (a), 2 * (a), 3 * (a))
+    #define vi_add(a, b)       _mm_add_epi32(a, b)
+    #define vi_and(a, b)       _mm_and_si128(a, b)
+    #define vi_or(a, b)        _mm_or_si128(a, b)
+    #define vi_shl(a, n)       _mm_slli_epi32(a, n)
+    #define vi_sll(a, n)       _mm_sll_epi32(a, _mm_cvtsi32_si128(n))
+    #define vi_srl(a, n)       _mm_srl_epi32(a, _mm_cvtsi32_si128(n))
+    #define vi_gt(a, b)        _mm_cmpgt_epi32(a, b)
+    #define vi_eq(a, b)        _mm_cmpeq_epi32(a, b)
+    #define vi_sub(a, b)       _mm_sub_epi32(a, b)
+    #define vi_add16(a, b)     _mm_add_epi16(a, b)
+    #define vi_sub16(a, b)     _mm_sub_epi16(a, b)
+    #define vi_mul16(a, b)     _mm_mullo_epi16(a, b)
+    #define vi_srl16(a, n)     _mm_srli_epi16(a, n)
+    #define vi_unpacklo8(a, b)  _mm_unpacklo_epi8(a, b)
+    #define vi_unpackhi8(a, b)  _mm_unpackhi_epi8(a, b)
+    #define vi_unpacklo16(a, b) _mm_unpacklo_epi16(a, b)
+    #define vi_unpacklo32(a, b) _mm_unpacklo_epi32(a, b)
+    #define vi_unpackhi32(a, b) _mm_unpackhi_epi32(a, b)
+    #define vi_packs32(a, b)    _mm_packs_epi32(a, b)
+    #define vi_packus16(a, b)   _mm_packus_epi16(a, b)
+#endif
+
+#if defined(NUSR_RASTER_AVX2) || defined(NUSR_RASTER_SSE2)
+    #define NUSR_RASTER_SIMD
+#endif
+
+/* edge values at block origin are clamped to keep 32 bits stepping exact */
+#define MAX_BLOCK_EDGE_VALUE ((int64_t)1 << 30)
+/* triangles with a bounding box up to this size (in pixels) test each
+ * pixel directly, must not exceed the coarse block size */
+#define SMALL_TRIANGLE_SIZE 4
+/* rotated grid sample positions relative to the pixel center, in sub pixels */
+static const int32_t msaa_offsets[NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT][2] = {
+    {-2, -6}, {6, -2}, {-6, 2}, {2, 6}
+};
+
+static float pixel_coverage(const nu_vec2_t a, const nu_vec2_t b, const nu_vec2_t c)
+{
+    return (c[0] - a[0]) * (b[1] - a[1]) - (c[1] - a[1]) * (b[0] - a[0]);
+}
+static void setup_edge(
+    nusr_triangle_t *triangle, uint32_t k,
+    const int64_t fa[2], const int64_t fb[2]
+)
+{
+    /* fixed point edge function evaluated at pixel centers */
+    int64_t ea = fb[1] - fa[1];
+    int64_t eb = fa[0] - fb[0];
+    const int64_t half = NUSR_RASTER_SUBPIXEL_STEP / 2;
+    triangle->edge_step_x[k] = ea * NUSR_RASTER_SUBPIXEL_STEP;
+    triangle->edge_step_y[k] = eb * NUSR_RASTER_SUBPIXEL_STEP;
+    triangle->edge_c[k] = ea * (half - fa[0]) + eb * (half - fa[1]);
+
+    /* top left rule, samples on a top or left edge are included so the
+     * test becomes e > 0 for every edge */
+    int64_t ex = fb[0] - fa[0];
+    int64_t ey = fb[1] - fa[1];
+    bool top_left = (ex != 0) ? (ex > 0) : (ey > 0);
+    if (top_left) triangle->edge_c[k] += 1;
+}
+static void setup_plane(float plane[3], const float ga[2], const float gb[2], float f0, float f1, float f2)
+{
+    /* gradients from the barycentric gradients of the two first vertices */
+    float d0 = f0 - f2;
+    float d1 = f1 - f2;
+    plane[0] = f0;
+    plane[1] = ga[0] * d0 + ga[1] * d1;
+    plane[2] = gb[0] * d0 + gb[1] * d1;
+}
+static float eval_plane(const float plane[3], float dx, float dy)
+{
+    /* same evaluation order as eval_plane_simd so both paths match */
+    return (plane[0] + plane[2] * dy) + plane[1] * dx;
+}
+static void interpolate_varyings(const nusr_triangle_t *t, float sx, float sy, uint32_t count, float *varyings)
+{
+    /* varyings / w and 1 / w are affine, one reciprocal per pixel */
+    const float dx = sx - t->v0[0];
+    const float dy = sy - t->v0[1];
+    const float w = 1.0f / eval_plane(t->inv_w, dx, dy);
+    for (uint32_t k = 0; k < count; k++) {
+        varyings[k] = eval_plane(t->varyings[k], dx, dy) * w;
+    }
+}
+static const nusr_texture_level_t *select_level(const nusr_triangle_t *t, float sx, float sy)
+{
+    /* texel footprint of one pixel, from uv differences at the sample */
+    const nusr_texture_t *texture = t->texture;
+    const float width = (float)texture->levels[0].width;
+    const float height = (float)texture->levels[0].height;
+    float uv[2], uvx[2], uvy[2];
+    interpolate_varyings(t, sx, sy, 2, uv);
+    interpolate_varyings(t, sx + 1.0f, sy, 2, uvx);
+    interpolate_varyings(t, sx, sy + 1.0f, 2, uvy);
+    float dux = (uvx[0] - uv[0]) * width;
+    float dvx = (uvx[1] - uv[1]) * height;
+    float duy = (uvy[0] - uv[0]) * width;
+    float dvy = (uvy[1] - uv[1]) * height;
+    float rho2 = NU_MAX(dux * dux + dvx * dvx, duy * duy + dvy * dvy);
+
+    /* floor(log2(rho)), invalid values fall back to the base level */
+    uint32_t level = 0;
+    while (rho2 >= 4.0f && level + 1 < texture->level_count) {
+        rho2 *= 0.25f;
+        level++;
+    }
+
+    return &texture->levels[level];
+}
+static const nusr_texture_level_t *block_level(const nusr_triangle_t *t, uint32_t id, uint32_t hx, uint32_t hy, const nusr_texture_level_t **level)
+{
+    /* the visibility pass does not sample textures */
+    if (id != NUSR_RASTER_NO_TRIANGLE) return NULL;
+
+    /* selected once per coarse block, on first coverage */
+    if (!*level) {
+        const float half = NUSR_RENDERBUFFER_HIZ_SIZE * 0.5f;
+        *level = select_level(t, hx + half, hy + half);
+    }
+    return *level;
+}
+static uint32_t morton_spread(uint32_t v)
+{
+    /* insert a zero bit between each of the 16 low bits */
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+static uint32_t texel_index(const nusr_texture_level_t *level, uint32_t x, uint32_t y)
+{
+    if (!level->swizzled) return y * level->width + x;
+    const uint32_t k = level->morton_bits;
+    const uint32_t mask = (1u << k) - 1;
+    return morton_spread(x & mask) | (morton_spread(y & mask) << 1) | (((x | y) >> k) << (2 * k));
+}
+static uint32_t sample_texture(const nusr_texture_level_t *level, float u, float v)
+{
+    int32_t x = (int32_t)(u * level->width);
+    int32_t y = (int32_t)(v * level->height);
+    x = NU_MAX(0, NU_MIN((int32_t)level->width - 1, x));
+    y = NU_MAX(0, NU_MIN((int32_t)level->height - 1, y));
+    return level->data[texel_index(level, x, y)];
+}
+static uint32_t lerp_texels(uint32_t a, uint32_t b, uint32_t w)
+{
+    /* (a * (256 - w) + b * w + 128) >> 8 per channel, two channels per
+     * word 16 bits apart so products never carry into the next one */
+    const uint32_t mask = 0x00FF00FF;
+    uint32_t ga = a & mask;
+    uint32_t gb = b & mask;
+    uint32_t rba = (a >> 8) & mask;
+    uint32_t rbb = (b >> 8) & mask;
+    uint32_t g = ((ga * (256 - w) + gb * w + 0x00800080) >> 8) & mask;
+    uint32_t rb = ((rba * (256 - w) + rbb * w + 0x00800080) >> 8) & mask;
+    return (rb << 8) | g;
+}
+static uint32_t sample_texture_bilinear(const nusr_texture_level_t *level, float u, float v)
+{
+    /* 8.8 fixed point coordinates relative to texel centers, clamped to edge */
+    float x = NU_MAX(0.0f, NU_MIN((float)level->width - 1.0f, u * level->width - 0.5f));
+    float y = NU_MAX(0.0f, NU_MIN((float)level->height - 1.0f, v * level->height - 0.5f));
+    uint32_t xf = (uint32_t)(int32_t)(x * 256.0f);
+    uint32_t yf = (uint32_t)(int32_t)(y * 256.0f);
+    uint32_t x0 = xf >> 8;
+    uint32_t y0 = yf >> 8;
+    uint32_t x1 = x0 + (x0 < level->width - 1);
+    uint32_t y1 = y0 + (y0 < level->height - 1);
+    uint32_t fx = xf & 0xFF;
+    uint32_t fy = yf & 0xFF;
+
+    uint32_t top = lerp_texels(level->data[texel_index(level, x0, y0)], level->data[texel_index(level, x1, y0)], fx);
+    uint32_t bottom = lerp_texels(level->data[texel_index(level, x0, y1)], level->data[texel_index(level, x1, y1)], fx);
+    return lerp_texels(top, bottom, fy);
+}
+static float load_depth(const nusr_renderbuffer_t *renderbuffer, uint32_t index)
+{
+    /* stored depth as a float, normalized values are exact */
+    switch (renderbuffer->depth_format) {
+        case NUSR_DEPTH_FORMAT_UNORM24:
+            return (float)renderbuffer->depth_buffer.pixels[index].as_uint;
+        case NUSR_DEPTH_FORMAT_UNORM16:
+            return (float)renderbuffer->depth16[index];
+        default:
+            return renderbuffer->depth_buffer.pixels[index].as_float;
+    }
+}
+static bool depth_test(nusr_renderbuffer_t *renderbuffer, uint32_t index, float depth)
+{
+    /* normalized values are truncated, clamping keeps the far clear value
+     * unreachable */
+    switch (renderbuffer->depth_format) {
+        case NUSR_DEPTH_FORMAT_UNORM24: {
+            uint32_t d = (uint32_t)NU_MIN(NU_MAX(depth, 0.0f), (float)NUSR_DEPTH_UNORM24_MAX);
+            if (d >= renderbuffer->depth_buffer.pixels[index].as_uint) return false;
+            renderbuffer->depth_buffer.pixels[index].as_uint = d;
+            break;
+        }
+        case NUSR_DEPTH_FORMAT_UNORM16: {
+            uint32_t d = (uint32_t)NU_MIN(NU_MAX(depth, 0.0f), (float)NUSR_DEPTH_UNORM16_MAX);
+            if (d >= renderbuffer->depth16[index]) return false;
+            renderbuffer->depth16[index] = d;
+            break;
+        }
+        default:
+            if (depth >= renderbuffer->depth_buffer.pixels[index].as_float) return false;
+            renderbuffer->depth_buffer.pixels[index].as_float = depth;
+            break;
+    }
+    return true;
+}
+#if defined(NUSR_RASTER_SIMD)
+static vint_t load_depth16_simd(const uint16_t *p)
+{
+#if defined(NUSR_RASTER_AVX2)
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p));
+#else
+    return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+#endif
+}
+static void store_depth16_simd(uint16_t *p, vint_t v)
+{
+    /* signed saturation is made unsigned with a 0x8000 bias */
+    v = vi_sub(v, vi_set1(0x8000));
+#if defined(NUSR_RASTER_AVX2)
+    __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storeu_si128((__m128i*)p, _mm_xor_si128(packed, _mm_set1_epi16((short)0x8000)));
+#else
+    __m128i packed = _mm_packs_epi32(v, v);
+    _mm_storel_epi64((__m128i*)p, _mm_xor_si128(packed, _mm_set1_epi16((short)0x8000)));
+#endif
+}
+static vfloat_t load_depth_simd(const nusr_renderbuffer_t *renderbuffer, uint32_t index)
+{
+    switch (renderbuffer->depth_format) {
+        case NUSR_DEPTH_FORMAT_UNORM24:
+            return vf_from_int(vf_as_bits(vf_loadu(&renderbuffer->depth_buffer.pixels[index])));
+        case NUSR_DEPTH_FORMAT_UNORM16:
+            return vf_from_int(load_depth16_simd(&renderbuffer->depth16[index]));
+        default:
+            return vf_loadu(&renderbuffer->depth_buffer.pixels[index]);
+    }
+}
+static int depth_test_simd(nusr_renderbuffer_t *renderbuffer, uint32_t index, vfloat_t depth, vfloat_t coverage, vfloat_t *pass)
+{
+    int pass_mask;
+    switch (renderbuffer->depth_format) {
+        case NUSR_DEPTH_FORMAT_UNORM24: {
+            nusr_framebuffer_pixel_t *pixels = &renderbuffer->depth_buffer.pixels[index];
+            vint_t d = vf_to_int(vf_min(vf_max(depth, vf_zero()), vf_set1((float)NUSR_DEPTH_UNORM24_MAX)));
+            vint_t stored = vf_as_bits(vf_loadu(pixels));
+            *pass = vf_and(coverage, vf_from_bits(vi_gt(stored, d)));
+            pass_mask = vf_movemask(*pass);
+            if (pass_mask) vf_storeu(pixels, vf_select(*pass, vf_from_bits(d), vf_from_bits(stored)));
+            break;
+        }
+        case NUSR_DEPTH_FORMAT_UNORM16: {
+            uint16_t *pixels = &renderbuffer->depth16[index];
+            vint_t d = vf_to_int(vf_min(vf_max(depth, vf_zero()), vf_set1((float)NUSR_DEPTH_UNORM16_MAX)));
+            vint_t stored = load_depth16_simd(pixels);
+            *pass = vf_and(coverage, vf_from_bits(vi_gt(stored, d)));
+            pass_mask = vf_movemask(*pass);
+            if (pass_mask) store_depth16_simd(pixels, vf_as_bits(vf_select(*pass, vf_from_bits(d), vf_from_bits(stored))));
+            break;
+        }
+        default: {
+            nusr_framebuffer_pixel_t *pixels = &renderbuffer->depth_buffer.pixels[index];
+            vfloat_t stored = vf_loadu(pixels);
+            *pass = vf_and(coverage, vf_lt(depth, stored));
+            pass_mask = vf_movemask(*pass);
+            if (pass_mask) vf_storeu(pixels, vf_select(*pass, depth, stored));
+            break;
+        }
+    }
+    return pass_mask;
+}
+#endif
+
+static uint32_t modulate_texel(uint32_t texel, const float color[3])
+{
+    /* red, green and blue in the three high bytes scaled by the color */
+    uint32_t result = 0;
+    for (uint32_t c = 0; c < 3; c++) {
+        const uint32_t shift = 24 - 8 * c;
+        float f = NU_MAX(0.0f, NU_MIN(1.0f, color[c]));
+        result |= (uint32_t)((float)((texel >> shift) & 0xFF) * f) << shift;
+    }
+    return result;
+}
+static uint32_t shade_pixel(const nusr_triangle_t *t, const nusr_texture_level_t *level, float sx, float sy)
+{
+    float varyings[NUSR_RASTER_MAX_VARYING_COUNT];
+    interpolate_varyings(t, sx, sy, t->varying_count, varyings);
+    const float u = varyings[NUSR_RASTER_VARYING_U];
+    const float v = varyings[NUSR_RASTER_VARYING_V];
+    uint32_t texel = (t->texture->filter == NU_RENDERER_TEXTURE_FILTER_BILINEAR)
+        ? sample_texture_bilinear(level, u, v)
+        : sample_texture(level, u, v);
+    if (t->varying_count > NUSR_RASTER_VARYING_COLOR) {
+        texel = modulate_texel(texel, &varyings[NUSR_RASTER_VARYING_COLOR]);
+    }
+    return texel;
+}
+static void raster_pixels(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    uint32_t id,
+    const nusr_texture_level_t *level,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+)
+{
+    const nusr_triangle_t *t = triangle;
+    const uint32_t width = renderbuffer->color_buffer.width;
+
+    /* edge functions at the first row */
+    int64_t e_row[3];
+    for (uint32_t k = 0; k < 3; k++) {
+        e_row[k] = t->edge_c[k] + t->edge_step_x[k] * xmin + t->edge_step_y[k] * ymin;
+    }
+
+    for (uint32_t j = ymin; j < ymax; j++) {
+        int64_t e[3] = {e_row[0], e_row[1], e_row[2]};
+        for (uint32_t i = xmin; i < xmax; i++) {
+            /* check sample with top left rule */
+            bool included = (e[0] > 0) & (e[1] > 0) & (e[2] > 0);
+            e[0] += t->edge_step_x[0];
+            e[1] += t->edge_step_x[1];
+            e[2] += t->edge_step_x[2];
+            if (!included) continue;
+
+            const float sx = i + 0.5f;
+            const float sy = j + 0.5f;
+
+            /* depth test */
+            float depth = t->v0[2] + t->zx * (sx - t->v0[0]) + t->zy * (sy - t->v0[1]);
+            if (!depth_test(renderbuffer, j * width + i, depth)) continue;
+            renderbuffer->hiz_dirty[(j / NUSR_RENDERBUFFER_HIZ_SIZE) * renderbuffer->hiz_width + i / NUSR_RENDERBUFFER_HIZ_SIZE] = true;
+
+            /* write the triangle id in the visibility pass, shade otherwise */
+            renderbuffer->color_buffer.pixels[j * width + i].as_uint = (id != NUSR_RASTER_NO_TRIANGLE) ? id : shade_pixel(t, level, sx, sy);
+        }
+        e_row[0] += t->edge_step_y[0];
+        e_row[1] += t->edge_step_y[1];
+        e_row[2] += t->edge_step_y[2];
+    }
+}
+
+typedef struct {
+    /* edge and depth offsets of each sample from the pixel center */
+    int64_t edge[NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT][3];
+    float depth[NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT];
+} nusr_sample_offsets_t;
+
+static void setup_sample_offsets(const nusr_triangle_t *t, nusr_sample_offsets_t *offsets)
+{
+    /* edge steps are multiples of the sub pixel step so offsets are exact */
+    for (uint32_t s = 0; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+        const int64_t dx = msaa_offsets[s][0];
+        const int64_t dy = msaa_offsets[s][1];
+        for (uint32_t k = 0; k < 3; k++) {
+            offsets->edge[s][k] = (t->edge_step_x[k] * dx + t->edge_step_y[k] * dy) / NUSR_RASTER_SUBPIXEL_STEP;
+        }
+        offsets->depth[s] = (t->zx * dx + t->zy * dy) / NUSR_RASTER_SUBPIXEL_STEP;
+    }
+}
+typedef enum {
+    BLOCK_OUTSIDE,
+    BLOCK_INSIDE,
+    BLOCK_PARTIAL
+} nusr_block_class_t;
+
+static nusr_block_class_t classify_block(
+    const nusr_triangle_t *triangle,
+    const int64_t edge_origin[3],
+    uint32_t size
+)
+{
+    const int64_t last = size - 1;
+    bool inside = true;
+    for (uint32_t k = 0; k < 3; k++) {
+        /* edge functions are linear, extremums are on the block corners */
+        int64_t dx = triangle->edge_step_x[k] * last;
+        int64_t dy = triangle->edge_step_y[k] * last;
+        int64_t emin = edge_origin[k] + NU_MIN(0, dx) + NU_MIN(0, dy);
+        int64_t emax = edge_origin[k] + NU_MAX(0, dx) + NU_MAX(0, dy);
+        if (emax <= 0) return BLOCK_OUTSIDE;
+        inside &= emin > 0;
+    }
+    return inside ? BLOCK_INSIDE : BLOCK_PARTIAL;
+}
+static nusr_block_class_t classify_block_samples(
+    const nusr_triangle_t *triangle,
+    const nusr_sample_offsets_t *offsets,
+    const int64_t edge_origin[3],
+    uint32_t size
+)
+{
+    /* multisampled blocks combine the classes of each sample position */
+    if (!offsets) return classify_block(triangle, edge_origin, size);
+    bool inside = true;
+    bool outside = true;
+    for (uint32_t s = 0; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+        int64_t e[3];
+        for (uint32_t k = 0; k < 3; k++) e[k] = edge_origin[k] + offsets->edge[s][k];
+        nusr_block_class_t sample_class = classify_block(triangle, e, size);
+        inside &= sample_class == BLOCK_INSIDE;
+        outside &= sample_class == BLOCK_OUTSIDE;
+    }
+    if (outside) return BLOCK_OUTSIDE;
+    return inside ? BLOCK_INSIDE : BLOCK_PARTIAL;
+}
+static void raster_pixels_msaa(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    const nusr_sample_offsets_t *offsets,
+    const nusr_texture_level_t *level,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+)
+{
+    const nusr_triangle_t *t = triangle;
+    const uint32_t width = renderbuffer->color_buffer.width;
+    const uint32_t stride = renderbuffer->sample_stride;
+
+    /* edge functions at the first row */
+    int64_t e_row[3];
+    for (uint32_t k = 0; k < 3; k++) {
+        e_row[k] = t->edge_c[k] + t->edge_step_x[k] * xmin + t->edge_step_y[k] * ymin;
+    }
+
+    for (uint32_t j = ymin; j < ymax; j++) {
+        int64_t e[3] = {e_row[0], e_row[1], e_row[2]};
+        for (uint32_t i = xmin; i < xmax; i++) {
+            const uint32_t index = j * width + i;
+            const float sx = i + 0.5f;
+            const float sy = j + 0.5f;
+            const float depth = t->v0[2] + t->zx * (sx - t->v0[0]) + t->zy * (sy - t->v0[1]);
+
+            /* coverage and depth test per sample */
+            uint32_t mask = 0;
+            for (uint32_t s = 0; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+                const int64_t *o = offsets->edge[s];
+                bool included = (e[0] + o[0] > 0) & (e[1] + o[1] > 0) & (e[2] + o[2] > 0);
+                if (included && depth_test(renderbuffer, s * stride + index, depth + offsets->depth[s])) {
+                    mask |= 1 << s;
+                }
+            }
+            e[0] += t->edge_step_x[0];
+            e[1] += t->edge_step_x[1];
+            e[2] += t->edge_step_x[2];
+            if (!mask) continue;
+            renderbuffer->hiz_dirty[(j / NUSR_RENDERBUFFER_HIZ_SIZE) * renderbuffer->hiz_width + i / NUSR_RENDERBUFFER_HIZ_SIZE] = true;
+
+            /* shade once at the pixel center, write passing samples */
+            const uint32_t color = shade_pixel(t, level, sx, sy);
+            for (uint32_t s = 0; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+                if (mask & (1 << s)) renderbuffer->sample_buffer.pixels[s * stride + index].as_uint = color;
+            }
+        }
+        e_row[0] += t->edge_step_y[0];
+        e_row[1] += t->edge_step_y[1];
+        e_row[2] += t->edge_step_y[2];
+    }
+}
+
+static float hiz_max_depth(nusr_renderbuffer_t *renderbuffer, uint32_t hx, uint32_t hy)
+{
+    /* recompute the farthest depth of the block from the depth buffer */
+    const uint32_t width = renderbuffer->color_buffer.width;
+    const uint32_t xmin = hx;
+    const uint32_t ymin = hy;
+    const uint32_t xmax = NU_MIN(xmin + NUSR_RENDERBUFFER_HIZ_SIZE, width);
+    const uint32_t ymax = NU_MIN(ymin + NUSR_RENDERBUFFER_HIZ_SIZE, renderbuffer->color_buffer.height);
+    float max_depth = load_depth(renderbuffer, ymin * width + xmin);
+    for (uint32_t s = 0; s < renderbuffer->sample_count; s++) {
+        const uint32_t plane = s * renderbuffer->sample_stride;
+#if defined(NUSR_RASTER_SIMD)
+        if (xmax - xmin == NUSR_RENDERBUFFER_HIZ_SIZE) {
+            vfloat_t max_row = load_depth_simd(renderbuffer, plane + ymin * width + xmin);
+            for (uint32_t y = ymin; y < ymax; y++) {
+                for (uint32_t x = xmin; x < xmax; x += BLOCK_SIZE) {
+                    max_row = vf_max(max_row, load_depth_simd(renderbuffer, plane + y * width + x));
+                }
+            }
+            NU_ALIGN(32) float lanes[BLOCK_SIZE];
+            vf_storeu(lanes, max_row);
+            for (uint32_t l = 0; l < BLOCK_SIZE; l++) max_depth = NU_MAX(max_depth, lanes[l]);
+            continue;
+        }
+#endif
+        for (uint32_t y = ymin; y < ymax; y++) {
+            for (uint32_t x = xmin; x < xmax; x++) {
+                max_depth = NU_MAX(max_depth, load_depth(renderbuffer, plane + y * width + x));
+            }
+        }
+    }
+    return max_depth;
+}
+
+typedef enum {
+    HIZ_UNKNOWN,
+    HIZ_VISIBLE,
+    HIZ_OCCLUDED
+} nusr_hiz_state_t;
+
+static bool block_occluded(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    uint32_t hx, uint32_t hy,
+    nusr_hiz_state_t *state
+)
+{
+    /* the test is done once per coarse block, on first coverage */
+    if (*state != HIZ_UNKNOWN) return *state == HIZ_OCCLUDED;
+    *state = HIZ_VISIBLE;
+
+    /* nearest depth of the triangle plane over the block samples, extra
+     * samples stay within half a pixel of the center */
+    const nusr_triangle_t *t = triangle;
+    const float margin = (renderbuffer->sample_count > 1) ? 0.5f : 0.0f;
+    const float last = (float)(NUSR_RENDERBUFFER_HIZ_SIZE - 1) + 2.0f * margin;
+    float depth = t->v0[2] + t->zx * (hx + 0.5f - margin - t->v0[0]) + t->zy * (hy + 0.5f - margin - t->v0[1]);
+    depth += NU_MIN(0.0f, t->zx * last) + NU_MIN(0.0f, t->zy * last);
+    depth = NU_MAX(depth, t->zmin);
+
+    /* depth writes only decrease values so a dirty block max is still an
+     * upper bound, the exact value is only recomputed when it may help */
+    const uint32_t index = (hy / NUSR_RENDERBUFFER_HIZ_SIZE) * renderbuffer->hiz_width + hx / NUSR_RENDERBUFFER_HIZ_SIZE;
+    if (depth < renderbuffer->hiz_max_depth[index] && renderbuffer->hiz_dirty[index]) {
+        renderbuffer->hiz_max_depth[index] = hiz_max_depth(renderbuffer, hx, hy);
+        renderbuffer->hiz_dirty[index] = false;
+    }
+
+    /* every sample would fail the depth test */
+    if (depth >= renderbuffer->hiz_max_depth[index]) *state = HIZ_OCCLUDED;
+    return *state == HIZ_OCCLUDED;
+}
+
+#if defined(NUSR_RASTER_SIMD)
+static int block_coverage(
+    const nusr_triangle_t *triangle,
+    const int64_t edge_origin[3],
+    uint32_t bx, uint32_t by,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    vfloat_t coverage[BLOCK_SIZE]
+)
+{
+    const nusr_triangle_t *t = triangle;
+
+    /* columns outside the area are never covered */
+    const vfloat_t sx = vf_add(vf_set1(bx + 0.5f), vf_lanes());
+    const vfloat_t column_mask = vf_and(vf_gt(sx, vf_set1(xmin)), vf_lt(sx, vf_set1(xmax)));
+
+    /* fixed point edge functions at the block origin, values far from the
+     * edge are clamped since the sign can not change inside the block */
+    vint_t edge_row[3];
+    vint_t edge_step[3];
+    for (uint32_t k = 0; edge_origin && k < 3; k++) {
+        int64_t e = NU_MAX(-MAX_BLOCK_EDGE_VALUE, NU_MIN(MAX_BLOCK_EDGE_VALUE, edge_origin[k]));
+        edge_row[k] = vi_add(vi_set1((int32_t)e), vi_ramp((int32_t)t->edge_step_x[k]));
+        edge_step[k] = vi_set1((int32_t)t->edge_step_y[k]);
+    }
+
+    /* compute block coverage masks, stepping is done with adds only, a
+     * missing edge origin means the block is inside the triangle */
+    const vint_t izero = vi_set1(0);
+    int block_mask = 0;
+    for (uint32_t r = 0; r < BLOCK_SIZE; r++) {
+        const uint32_t y = by + r;
+        coverage[r] = vf_zero();
+        if (y >= ymin && y < ymax) {
+            coverage[r] = column_mask;
+            if (edge_origin) {
+                vint_t included = vi_and(vi_gt(edge_row[0], izero), vi_and(vi_gt(edge_row[1], izero), vi_gt(edge_row[2], izero)));
+                coverage[r] = vf_and(column_mask, vf_from_bits(included));
+            }
+            block_mask |= vf_movemask(coverage[r]);
+        }
+        if (edge_origin) {
+            edge_row[0] = vi_add(edge_row[0], edge_step[0]);
+            edge_row[1] = vi_add(edge_row[1], edge_step[1]);
+            edge_row[2] = vi_add(edge_row[2], edge_step[2]);
+        }
+    }
+
+    return block_mask;
+}
+static vint_t morton_spread_simd(vint_t v)
+{
+    v = vi_and(vi_or(v, vi_shl(v, 8)), vi_set1(0x00FF00FF));
+    v = vi_and(vi_or(v, vi_shl(v, 4)), vi_set1(0x0F0F0F0F));
+    v = vi_and(vi_or(v, vi_shl(v, 2)), vi_set1(0x33333333));
+    v = vi_and(vi_or(v, vi_shl(v, 1)), vi_set1(0x55555555));
+    return v;
+}
+static vint_t morton_index_simd(const nusr_texture_level_t *level, vint_t x, vint_t y)
+{
+    const uint32_t k = level->morton_bits;
+    const vint_t mask = vi_set1((1 << k) - 1);
+    vint_t low = vi_or(morton_spread_simd(vi_and(x, mask)), vi_shl(morton_spread_simd(vi_and(y, mask)), 1));
+    vint_t high = vi_sll(vi_srl(vi_or(x, y), k), 2 * k);
+    return vi_or(low, high);
+}
+static vint_t fetch_texels_simd(const nusr_texture_level_t *level, vint_t x, vint_t y, vfloat_t pass, int pass_mask)
+{
+#if defined(NUSR_RASTER_AVX2)
+    (void)pass_mask;
+    vint_t index = level->swizzled ? morton_index_simd(level, x, y) : vi_add(vi_mul(y, vi_set1(level->width)), x);
+    return _mm256_mask_i32gather_epi32(vi_set1(0), (const int*)level->data, index, vf_as_bits(pass), 4);
+#else
+    (void)pass;
+    NU_ALIGN(16) int32_t xs[BLOCK_SIZE];
+    NU_ALIGN(16) int32_t ys[BLOCK_SIZE];
+    NU_ALIGN(16) uint32_t colors[BLOCK_SIZE];
+    if (level->swizzled) {
+        _mm_store_si128((vint_t*)xs, morton_index_simd(level, x, y));
+        for (uint32_t l = 0; l < BLOCK_SIZE; l++) {
+            colors[l] = (pass_mask & (1 << l)) ? level->data[xs[l]] : 0;
+        }
+    } else {
+        /* no 32 bits multiply in SSE2 */
+        _mm_store_si128((vint_t*)xs, x);
+        _mm_store_si128((vint_t*)ys, y);
+        for (uint32_t l = 0; l < BLOCK_SIZE; l++) {
+            colors[l] = (pass_mask & (1 << l)) ? level->data[ys[l] * level->width + xs[l]] : 0;
+        }
+    }
+    return _mm_load_si128((const vint_t*)colors);
+#endif
+}
+static vint_t sample_texture_simd(const nusr_texture_level_t *level, vfloat_t u, vfloat_t v, vfloat_t pass, int pass_mask)
+{
+    const vfloat_t zero = vf_zero();
+    vint_t x = vf_to_int(vf_max(zero, vf_min(vf_set1((float)level->width - 1.0f), vf_mul(u, vf_set1((float)level->width)))));
+    vint_t y = vf_to_int(vf_max(zero, vf_min(vf_set1((float)level->height - 1.0f), vf_mul(v, vf_set1((float)level->height)))));
+    return fetch_texels_simd(level, x, y, pass, pass_mask);
+}
+static vint_t lerp_texels_simd(vint_t a, vint_t b, vint_t w)
+{
+    /* (a * (256 - w) + b * w + 128) >> 8 on 16 bits channels */
+    const vint_t one = vi_set1(0x01000100);
+    const vint_t half = vi_set1(0x00800080);
+    return vi_srl16(vi_add16(vi_add16(vi_mul16(a, vi_sub16(one, w)), vi_mul16(b, w)), half), 8);
+}
+static vint_t sample_texture_bilinear_simd(const nusr_texture_level_t *level, vfloat_t u, vfloat_t v, vfloat_t pass, int pass_mask)
+{
+    /* 8.8 fixed point coordinates relative to texel centers, clamped to edge */
+    const vfloat_t zero = vf_zero();
+    const vfloat_t half = vf_set1(0.5f);
+    const vfloat_t scale = vf_set1(256.0f);
+    vfloat_t x = vf_max(zero, vf_min(vf_set1((float)level->width - 1.0f), vf_sub(vf_mul(u, vf_set1((float)level->width)), half)));
+    vfloat_t y = vf_max(zero, vf_min(vf_set1((float)level->height - 1.0f), vf_sub(vf_mul(v, vf_set1((float)level->height)), half)));
+    vint_t xf = vf_to_int(vf_mul(x, scale));
+    vint_t yf = vf_to_int(vf_mul(y, scale));
+    vint_t x0 = vi_srl(xf, 8);
+    vint_t y0 = vi_srl(yf, 8);
+    vint_t x1 = vi_sub(x0, vi_gt(vi_set1(level->width - 1), x0));
+    vint_t y1 = vi_sub(y0, vi_gt(vi_set1(level->height - 1), y0));
+    vint_t fx = vi_and(xf, vi_set1(0xFF));
+    vint_t fy = vi_and(yf, vi_set1(0xFF));
+
+    /* fetch the 4 texels of each pixel */
+    vint_t c00 = fetch_texels_simd(level, x0, y0, pass, pass_mask);
+    vint_t c10 = fetch_texels_simd(level, x1, y0, pass, pass_mask);
+    vint_t c01 = fetch_texels_simd(level, x0, y1, pass, pass_mask);
+    vint_t c11 = fetch_texels_simd(level, x1, y1, pass, pass_mask);
+
+    /* broadcast weights to the 4 channels of their pixel, split in low and
+     * high pixels the same way bytes are unpacked to 16 bits */
+    vint_t fx16 = vi_packs32(fx, fx);
+    vint_t fy16 = vi_packs32(fy, fy);
+    fx16 = vi_unpacklo16(fx16, fx16);
+    fy16 = vi_unpacklo16(fy16, fy16);
+    vint_t fx_lo = vi_unpacklo32(fx16, fx16);
+    vint_t fx_hi = vi_unpackhi32(fx16, fx16);
+    vint_t fy_lo = vi_unpacklo32(fy16, fy16);
+    vint_t fy_hi = vi_unpackhi32(fy16, fy16);
+
+    /* blend horizontally then vertically */
+    const vint_t z = vi_set1(0);
+    vint_t lo = lerp_texels_simd(
+        lerp_texels_simd(vi_unpacklo8(c00, z), vi_unpacklo8(c10, z), fx_lo),
+        lerp_texels_simd(vi_unpacklo8(c01, z), vi_unpacklo8(c11, z), fx_lo),
+        fy_lo
+    );
+    vint_t hi = lerp_texels_simd(
+        lerp_texels_simd(vi_unpackhi8(c00, z), vi_unpackhi8(c10, z), fx_hi),
+        lerp_texels_simd(vi_unpackhi8(c01, z), vi_unpackhi8(c11, z), fx_hi),
+        fy_hi
+    );
+    return vi_packus16(lo, hi);
+}
+static vfloat_t eval_plane_simd(const float plane[3], vfloat_t dx, float dy)
+{
+    return vf_add(vf_set1(plane[0] + plane[2] * dy), vf_mul(vf_set1(plane[1]), dx));
+}
+static vint_t modulate_texels_simd(vint_t texels, const vfloat_t color[3])
+{
+    /* same as modulate_texel */
+    vint_t result = vi_set1(0);
+    for (uint32_t c = 0; c < 3; c++) {
+        const uint32_t shift = 24 - 8 * c;
+        vfloat_t f = vf_max(vf_zero(), vf_min(vf_set1(1.0f), color[c]));
+        vint_t channel = vi_and(vi_srl(texels, shift), vi_set1(0xFF));
+        result = vi_or(result, vi_sll(vf_to_int(vf_mul(vf_from_int(channel), f)), shift));
+    }
+    return result;
+}
+static vint_t shade_simd(
+    const nusr_triangle_t *t,
+    const nusr_texture_level_t *level,
+    vfloat_t dx, float dy,
+    vfloat_t pass, int pass_mask
+)
+{
+    /* same as shade_pixel, dx and dy are relative to the first vertex */
+    vfloat_t varyings[NUSR_RASTER_MAX_VARYING_COUNT];
+    const vfloat_t w = vf_div(vf_set1(1.0f), eval_plane_simd(t->inv_w, dx, dy));
+    for (uint32_t k = 0; k < t->varying_count; k++) {
+        varyings[k] = vf_mul(eval_plane_simd(t->varyings[k], dx, dy), w);
+    }
+    const vfloat_t u = varyings[NUSR_RASTER_VARYING_U];
+    const vfloat_t v = varyings[NUSR_RASTER_VARYING_V];
+    vint_t texels = (t->texture->filter == NU_RENDERER_TEXTURE_FILTER_BILINEAR)
+        ? sample_texture_bilinear_simd(level, u, v, pass, pass_mask)
+        : sample_texture_simd(level, u, v, pass, pass_mask);
+    if (t->varying_count > NUSR_RASTER_VARYING_COLOR) {
+        texels = modulate_texels_simd(texels, &varyings[NUSR_RASTER_VARYING_COLOR]);
+    }
+    return texels;
+}
+static void raster_block(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    uint32_t id,
+    const nusr_texture_level_t *level,
+    uint32_t bx, uint32_t by,
+    const vfloat_t coverage[BLOCK_SIZE]
+)
+{
+    const nusr_triangle_t *t = triangle;
+    const uint32_t width = renderbuffer->color_buffer.width;
+    const vfloat_t lanes = vf_lanes();
+
+    /* pixel centers relative to the first vertex for varyings */
+    const vfloat_t dx = vf_sub(vf_add(vf_set1(bx + 0.5f), lanes), vf_set1(t->v0[0]));
+
+    /* depth test and shade covered rows */
+    const vfloat_t depth_row = vf_add(
+        vf_set1(t->v0[2] + t->zx * (bx + 0.5f - t->v0[0]) + t->zy * (by + 0.5f - t->v0[1])),
+        vf_mul(vf_set1(t->zx), lanes)
+    );
+    for (uint32_t r = 0; r < BLOCK_SIZE; r++) {
+        if (!vf_movemask(coverage[r])) continue;
+
+        const uint32_t y = by + r;
+        nusr_framebuffer_pixel_t *color_pixels = &renderbuffer->color_buffer.pixels[y * width + bx];
+
+        /* depth test */
+        vfloat_t depth = vf_add(depth_row, vf_set1(t->zy * r));
+        vfloat_t pass;
+        int pass_mask = depth_test_simd(renderbuffer, y * width + bx, depth, coverage[r], &pass);
+        if (!pass_mask) continue;
+        renderbuffer->hiz_dirty[(y / NUSR_RENDERBUFFER_HIZ_SIZE) * renderbuffer->hiz_width + bx / NUSR_RENDERBUFFER_HIZ_SIZE] = true;
+
+        /* visibility pass, write the triangle id */
+        if (id != NUSR_RASTER_NO_TRIANGLE) {
+            vf_storeu(color_pixels, vf_select(pass, vf_from_bits(vi_set1(id)), vf_loadu(color_pixels)));
+            continue;
+        }
+
+        /* perspective correct shading */
+        vint_t color = shade_simd(t, level, dx, (y + 0.5f) - t->v0[1], pass, pass_mask);
+
+        /* write covered pixels */
+        vf_storeu(color_pixels, vf_select(pass, vf_from_bits(color), vf_loadu(color_pixels)));
+    }
+}
+static void raster_simd_block(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    const int64_t edge_origin[3],
+    bool inside,
+    uint32_t bx, uint32_t by,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    uint32_t hx, uint32_t hy,
+    nusr_hiz_state_t *hiz,
+    uint32_t id,
+    const nusr_texture_level_t **level
+)
+{
+    const uint32_t pxmin = NU_MAX(bx, xmin);
+    const uint32_t pymin = NU_MAX(by, ymin);
+    const uint32_t pxmax = NU_MIN(bx + BLOCK_SIZE, xmax);
+    const uint32_t pymax = NU_MIN(by + BLOCK_SIZE, ymax);
+    vfloat_t coverage[BLOCK_SIZE];
+    if (bx + BLOCK_SIZE > renderbuffer->color_buffer.width) {
+        /* partial block on the framebuffer border */
+        if (block_occluded(renderbuffer, triangle, hx, hy, hiz)) return;
+        raster_pixels(renderbuffer, triangle, id, block_level(triangle, id, hx, hy, level), pxmin, pymin, pxmax, pymax);
+    } else if (triangle->guard_band && !inside) {
+        if (!block_coverage(triangle, edge_origin, bx, by, xmin, ymin, xmax, ymax, coverage)) return;
+        if (block_occluded(renderbuffer, triangle, hx, hy, hiz)) return;
+        raster_block(renderbuffer, triangle, id, block_level(triangle, id, hx, hy, level), bx, by, coverage);
+    } else {
+        /* edge steps of large triangles can overflow 32 bits, classify
+         * the block with its corners and only step partial blocks, blocks
+         * of a covered coarse block are inside */
+        nusr_block_class_t block_class = inside ? BLOCK_INSIDE : classify_block(triangle, edge_origin, BLOCK_SIZE);
+        if (block_class == BLOCK_OUTSIDE) return;
+        if (block_occluded(renderbuffer, triangle, hx, hy, hiz)) return;
+        if (block_class == BLOCK_INSIDE) {
+            block_coverage(triangle, NULL, bx, by, xmin, ymin, xmax, ymax, coverage);
+            raster_block(renderbuffer, triangle, id, block_level(triangle, id, hx, hy, level), bx, by, coverage);
+        } else {
+            raster_pixels(renderbuffer, triangle, id, block_level(triangle, id, hx, hy, level), pxmin, pymin, pxmax, pymax);
+        }
+    }
+}
+static void raster_block_msaa(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    const nusr_sample_offsets_t *offsets,
+    const nusr_texture_level_t *level,
+    uint32_t bx, uint32_t by,
+    vfloat_t coverage[NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT][BLOCK_SIZE]
+)
+{
+    const nusr_triangle_t *t = triangle;
+    const uint32_t width = renderbuffer->color_buffer.width;
+    const uint32_t stride = renderbuffer->sample_stride;
+    const vfloat_t lanes = vf_lanes();
+
+    /* pixel centers relative to the first vertex for varyings */
+    const vfloat_t dx = vf_sub(vf_add(vf_set1(bx + 0.5f), lanes), vf_set1(t->v0[0]));
+
+    /* depth test each sample plane and shade the rows once */
+    const vfloat_t depth_row = vf_add(
+        vf_set1(t->v0[2] + t->zx * (bx + 0.5f - t->v0[0]) + t->zy * (by + 0.5f - t->v0[1])),
+        vf_mul(vf_set1(t->zx), lanes)
+    );
+    for (uint32_t r = 0; r < BLOCK_SIZE; r++) {
+        const uint32_t index = (by + r) * width + bx;
+        const vfloat_t depth = vf_add(depth_row, vf_set1(t->zy * r));
+        vfloat_t pass[NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT];
+        vfloat_t pixel_pass = vf_zero();
+        int pass_mask = 0;
+        for (uint32_t s = 0; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+            pass[s] = vf_zero();
+            if (!vf_movemask(coverage[s][r])) continue;
+            pass_mask |= depth_test_simd(renderbuffer, s * stride + index, vf_add(depth, vf_set1(offsets->depth[s])), coverage[s][r], &pass[s]);
+            pixel_pass = vf_or(pixel_pass, pass[s]);
+        }
+        if (!pass_mask) continue;
+        renderbuffer->hiz_dirty[((by + r) / NUSR_RENDERBUFFER_HIZ_SIZE) * renderbuffer->hiz_width + bx / NUSR_RENDERBUFFER_HIZ_SIZE] = true;
+
+        /* perspective correct shading at the pixel centers */
+        vint_t color = shade_simd(t, level, dx, (by + r + 0.5f) - t->v0[1], pixel_pass, pass_mask);
+
+        /* write passing samples */
+        for (uint32_t s = 0; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+            if (!vf_movemask(pass[s])) continue;
+            nusr_framebuffer_pixel_t *sample_pixels = &renderbuffer->sample_buffer.pixels[s * stride + index];
+            vf_storeu(sample_pixels, vf_select(pass[s], vf_from_bits(color), vf_loadu(sample_pixels)));
+        }
+    }
+}
+static void raster_simd_block_msaa(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    const nusr_sample_offsets_t *offsets,
+    const int64_t edge_origin[3],
+    bool inside,
+    uint32_t bx, uint32_t by,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    uint32_t hx, uint32_t hy,
+    nusr_hiz_state_t *hiz,
+    const nusr_texture_level_t **level
+)
+{
+    const uint32_t pxmin = NU_MAX(bx, xmin);
+    const uint32_t pymin = NU_MAX(by, ymin);
+    const uint32_t pxmax = NU_MIN(bx + BLOCK_SIZE, xmax);
+    const uint32_t pymax = NU_MIN(by + BLOCK_SIZE, ymax);
+    vfloat_t coverage[NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT][BLOCK_SIZE];
+
+    /* partial block on the framebuffer border */
+    if (bx + BLOCK_SIZE > renderbuffer->color_buffer.width) {
+        if (block_occluded(renderbuffer, triangle, hx, hy, hiz)) return;
+        raster_pixels_msaa(renderbuffer, triangle, offsets, block_level(triangle, NUSR_RASTER_NO_TRIANGLE, hx, hy, level), pxmin, pymin, pxmax, pymax);
+        return;
+    }
+
+    /* coverage of each sample, edge functions are offset at the block
+     * origin, blocks of a covered coarse block are inside */
+    int block_mask = 0;
+    nusr_block_class_t block_class = BLOCK_INSIDE;
+    if (triangle->guard_band && !inside) {
+        for (uint32_t s = 0; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+            int64_t e[3];
+            for (uint32_t k = 0; k < 3; k++) e[k] = edge_origin[k] + offsets->edge[s][k];
+            block_mask |= block_coverage(triangle, e, bx, by, xmin, ymin, xmax, ymax, coverage[s]);
+        }
+    } else {
+        /* large triangles, same as raster_simd_block */
+        if (!inside) block_class = classify_block_samples(triangle, offsets, edge_origin, BLOCK_SIZE);
+        block_mask = block_class != BLOCK_OUTSIDE;
+    }
+    if (!block_mask) return;
+    if (block_occluded(renderbuffer, triangle, hx, hy, hiz)) return;
+    if (!triangle->guard_band || inside) {
+        if (block_class == BLOCK_PARTIAL) {
+            raster_pixels_msaa(renderbuffer, triangle, offsets, block_level(triangle, NUSR_RASTER_NO_TRIANGLE, hx, hy, level), pxmin, pymin, pxmax, pymax);
+            return;
+        }
+        block_coverage(triangle, NULL, bx, by, xmin, ymin, xmax, ymax, coverage[0]);
+        for (uint32_t s = 1; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+            memcpy(coverage[s], coverage[0], sizeof(coverage[0]));
+        }
+    }
+    raster_block_msaa(renderbuffer, triangle, offsets, block_level(triangle, NUSR_RASTER_NO_TRIANGLE, hx, hy, level), bx, by, coverage);
+}
+#endif
+
+bool nusr_raster_triangle_setup(
+    nusr_triangle_t *triangle,
+    const float *varyings[3], uint32_t varying_count,
+    uint32_t width, uint32_t height
+)
+{
+    float *v[3] = {triangle->v0, triangle->v1, triangle->v2};
+
+    /* snap vertices to the sub pixel grid, clipping keeps them in range,
+     * anything else (nan included) is rejected before edges overflow */
+    int64_t fv[3][2];
+    for (uint32_t i = 0; i < 3; i++) {
+        for (uint32_t c = 0; c < 2; c++) {
+            if (!(fabsf(v[i][c]) < NUSR_RASTER_MAX_COORDINATE)) return false;
+            fv[i][c] = llrintf(v[i][c] * NUSR_RASTER_SUBPIXEL_STEP);
+            v[i][c] = (float)fv[i][c] / NUSR_RASTER_SUBPIXEL_STEP;
+        }
+    }
+
+    /* backface culling (exact) */
+    int64_t farea = (fv[2][0] - fv[0][0]) * (fv[1][1] - fv[0][1]) - (fv[2][1] - fv[0][1]) * (fv[1][0] - fv[0][0]);
+    if (farea <= 0) return false;
+    float area = pixel_coverage(v[0], v[1], v[2]);
+    float area_inv = 1.0f / area;
+
+    /* compute triangle viewport */
+    float xmin = NU_MIN(v[0][0], NU_MIN(v[1][0], v[2][0]));
+    float xmax = NU_MAX(v[0][0], NU_MAX(v[1][0], v[2][0]));
+    float ymin = NU_MIN(v[0][1], NU_MIN(v[1][1], v[2][1]));
+    float ymax = NU_MAX(v[0][1], NU_MAX(v[1][1], v[2][1]));
+    if (xmax <= 0 || ymax <= 0) return false;
+    triangle->xmin = (uint32_t)NU_MAX(0, xmin);
+    triangle->ymin = (uint32_t)NU_MAX(0, ymin);
+    triangle->xmax = (uint32_t)ceilf(NU_MIN((float)width, xmax));
+    triangle->ymax = (uint32_t)ceilf(NU_MIN((float)height, ymax));
+    if (triangle->xmin >= triangle->xmax || triangle->ymin >= triangle->ymax) return false;
+
+    /* edge steps depend on the triangle span only since block origins are clamped */
+    triangle->guard_band = (xmax - xmin) < NUSR_RASTER_GUARD_BAND && (ymax - ymin) < NUSR_RASTER_GUARD_BAND;
+
+    /* compute edges */
+    setup_edge(triangle, 0, fv[1], fv[2]);
+    setup_edge(triangle, 1, fv[2], fv[0]);
+    setup_edge(triangle, 2, fv[0], fv[1]);
+
+    /* barycentric gradients of the two first vertices, from their
+     * opposite edges */
+    const float ea[2] = {v[2][1] - v[1][1], v[0][1] - v[2][1]};
+    const float eb[2] = {v[1][0] - v[2][0], v[2][0] - v[0][0]};
+
+    /* compute depth plane gradients */
+    float d0 = v[0][2] - v[2][2];
+    float d1 = v[1][2] - v[2][2];
+    triangle->zx = (ea[0] * d0 + ea[1] * d1) * area_inv;
+    triangle->zy = (eb[0] * d0 + eb[1] * d1) * area_inv;
+    triangle->zmin = NU_MIN(v[0][2], NU_MIN(v[1][2], v[2][2]));
+
+    /* perspective correct varying planes */
+    const float ga[2] = {ea[0] * area_inv, ea[1] * area_inv};
+    const float gb[2] = {eb[0] * area_inv, eb[1] * area_inv};
+    float inv_w[3];
+    for (uint32_t i = 0; i < 3; i++) inv_w[i] = 1.0f / v[i][3];
+    setup_plane(triangle->inv_w, ga, gb, inv_w[0], inv_w[1], inv_w[2]);
+    triangle->varying_count = varying_count;
+    for (uint32_t k = 0; k < varying_count; k++) {
+        setup_plane(
+            triangle->varyings[k], ga, gb,
+            varyings[0][k] * inv_w[0], varyings[1][k] * inv_w[1], varyings[2][k] * inv_w[2]
+        );
+    }
+
+    return true;
+}
+static void raster_small_triangle(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    const nusr_sample_offsets_t *offsets,
+    uint32_t id,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+)
+{
+    const nusr_triangle_t *t = triangle;
+    const uint32_t width = renderbuffer->color_buffer.width;
+    const uint32_t stride = renderbuffer->sample_stride;
+    const uint32_t size = NUSR_RENDERBUFFER_HIZ_SIZE;
+
+    /* the bounding box spans at most two coarse blocks per axis, mip
+     * levels are still selected per coarse block like the other paths */
+    const nusr_texture_level_t *levels[2][2] = {{NULL, NULL}, {NULL, NULL}};
+    const uint32_t level_id = offsets ? NUSR_RASTER_NO_TRIANGLE : id;
+
+    for (uint32_t j = ymin; j < ymax; j++) {
+        for (uint32_t i = xmin; i < xmax; i++) {
+            /* edge functions evaluated at the pixel center directly */
+            int64_t e[3];
+            for (uint32_t k = 0; k < 3; k++) {
+                e[k] = t->edge_c[k] + t->edge_step_x[k] * i + t->edge_step_y[k] * j;
+            }
+
+            const uint32_t index = j * width + i;
+            const float sx = i + 0.5f;
+            const float sy = j + 0.5f;
+            const float depth = t->v0[2] + t->zx * (sx - t->v0[0]) + t->zy * (sy - t->v0[1]);
+
+            /* coverage and depth test per sample */
+            uint32_t mask = 0;
+            if (offsets) {
+                for (uint32_t s = 0; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+                    const int64_t *o = offsets->edge[s];
+                    bool included = (e[0] + o[0] > 0) & (e[1] + o[1] > 0) & (e[2] + o[2] > 0);
+                    if (included && depth_test(renderbuffer, s * stride + index, depth + offsets->depth[s])) {
+                        mask |= 1 << s;
+                    }
+                }
+            } else {
+                bool included = (e[0] > 0) & (e[1] > 0) & (e[2] > 0);
+                if (included && depth_test(renderbuffer, index, depth)) mask = 1;
+            }
+            if (!mask) continue;
+            renderbuffer->hiz_dirty[(j / size) * renderbuffer->hiz_width + i / size] = true;
+
+            const uint32_t hx = i - i % size;
+            const uint32_t hy = j - j % size;
+            const nusr_texture_level_t *level = block_level(
+                t, level_id, hx, hy, &levels[hy / size - ymin / size][hx / size - xmin / size]
+            );
+
+            /* write the triangle id in the visibility pass, shade otherwise */
+            if (!offsets) {
+                renderbuffer->color_buffer.pixels[index].as_uint = (id != NUSR_RASTER_NO_TRIANGLE) ? id : shade_pixel(t, level, sx, sy);
+                continue;
+            }
+            const uint32_t color = shade_pixel(t, level, sx, sy);
+            for (uint32_t s = 0; s < NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT; s++) {
+                if (mask & (1 << s)) renderbuffer->sample_buffer.pixels[s * stride + index].as_uint = color;
+            }
+        }
+    }
+}
+static void raster_triangle(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    uint32_t id,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+)
+{
+    /* clamp the triangle bounding box to the given area */
+    xmin = NU_MAX(xmin, triangle->xmin);
+    ymin = NU_MAX(ymin, triangle->ymin);
+    xmax = NU_MIN(xmax, triangle->xmax);
+    ymax = NU_MIN(ymax, triangle->ymax);
+    if (xmin >= xmax || ymin >= ymax) return;
+
+    /* the sample count selects specialized loops */
+    const bool msaa = renderbuffer->sample_count > 1;
+    nusr_sample_offsets_t offsets;
+    if (msaa) setup_sample_offsets(triangle, &offsets);
+
+    /* small triangles test their few samples directly, coarse block and
+     * simd setup would cost more than the samples themselves */
+    if (xmax - xmin <= SMALL_TRIANGLE_SIZE && ymax - ymin <= SMALL_TRIANGLE_SIZE) {
+        raster_small_triangle(renderbuffer, triangle, msaa ? &offsets : NULL, id, xmin, ymin, xmax, ymax);
+        return;
+    }
+
+#if defined(NUSR_RASTER_SIMD)
+    /* iterate over aligned coarse depth blocks, tiles are a multiple of the
+     * block size so a block never crosses the area of another tile */
+    const uint32_t size = NUSR_RENDERBUFFER_HIZ_SIZE;
+    const uint32_t hx0 = xmin - xmin % size;
+    const uint32_t hy0 = ymin - ymin % size;
+    int64_t e_row[3];
+    for (uint32_t k = 0; k < 3; k++) {
+        e_row[k] = triangle->edge_c[k] + triangle->edge_step_x[k] * hx0 + triangle->edge_step_y[k] * hy0;
+    }
+    for (uint32_t hy = hy0; hy < ymax; hy += size) {
+        for (uint32_t hx = hx0; hx < xmax; hx += size) {
+            int64_t e_hiz[3];
+            for (uint32_t k = 0; k < 3; k++) {
+                e_hiz[k] = e_row[k] + triangle->edge_step_x[k] * (hx - hx0);
+            }
+
+            /* skip coarse blocks outside the triangle, simd blocks of
+             * covered ones are filled without edge tests */
+            nusr_block_class_t coarse_class = classify_block_samples(triangle, msaa ? &offsets : NULL, e_hiz, size);
+            if (coarse_class == BLOCK_OUTSIDE) continue;
+            const bool inside = coarse_class == BLOCK_INSIDE;
+
+            /* rasterize simd blocks of the coarse block */
+            nusr_hiz_state_t hiz = HIZ_UNKNOWN;
+            const nusr_texture_level_t *level = NULL;
+            for (uint32_t by = NU_MAX(hy, ymin - ymin % BLOCK_SIZE); by < NU_MIN(hy + size, ymax); by += BLOCK_SIZE) {
+                for (uint32_t bx = NU_MAX(hx, xmin - xmin % BLOCK_SIZE); bx < NU_MIN(hx + size, xmax); bx += BLOCK_SIZE) {
+                    int64_t e[3];
+                    for (uint32_t k = 0; k < 3; k++) {
+                        e[k] = e_hiz[k] + triangle->edge_step_x[k] * (bx - hx) + triangle->edge_step_y[k] * (by - hy);
+                    }
+                    if (msaa) {
+                        raster_simd_block_msaa(renderbuffer, triangle, &offsets, e, inside, bx, by, xmin, ymin, xmax, ymax, hx, hy, &hiz, &level);
+                    } else {
+                        raster_simd_block(renderbuffer, triangle, e, inside, bx, by, xmin, ymin, xmax, ymax, hx, hy, &hiz, id, &level);
+                    }
+                }
+            }
+        }
+        for (uint32_t k = 0; k < 3; k++) e_row[k] += triangle->edge_step_y[k] * size;
+    }
+#else
+    /* iterate over coarse depth blocks */
+    const uint32_t size = NUSR_RENDERBUFFER_HIZ_SIZE;
+    for (uint32_t by = ymin - ymin % size; by < ymax; by += size) {
+        for (uint32_t bx = xmin - xmin % size; bx < xmax; bx += size) {
+            /* skip coarse blocks outside the triangle */
+            int64_t e[3];
+            for (uint32_t k = 0; k < 3; k++) {
+                e[k] = triangle->edge_c[k] + triangle->edge_step_x[k] * bx + triangle->edge_step_y[k] * by;
+            }
+            if (classify_block_samples(triangle, msaa ? &offsets : NULL, e, size) == BLOCK_OUTSIDE) continue;
+
+            nusr_hiz_state_t hiz = HIZ_UNKNOWN;
+            if (block_occluded(renderbuffer, triangle, bx, by, &hiz)) continue;
+            const nusr_texture_level_t *level = NULL;
+            const uint32_t pxmin = NU_MAX(bx, xmin);
+            const uint32_t pymin = NU_MAX(by, ymin);
+            const uint32_t pxmax = NU_MIN(bx + size, xmax);
+            const uint32_t pymax = NU_MIN(by + size, ymax);
+            if (msaa) {
+                raster_pixels_msaa(renderbuffer, triangle, &offsets, block_level(triangle, id, bx, by, &level), pxmin, pymin, pxmax, pymax);
+            } else {
+                raster_pixels(renderbuffer, triangle, id, block_level(triangle, id, bx, by, &level), pxmin, pymin, pxmax, pymax);
+            }
+        }
+    }
+#endif
+}
+#if defined(NUSR_RASTER_SIMD)
+static void resolve_simd_block(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangles,
+    uint32_t hx, uint32_t hy,
+    uint32_t bx, uint32_t y,
+    uint32_t *last_id,
+    const nusr_texture_level_t **level,
+    uint32_t clear_color
+)
+{
+    nusr_framebuffer_pixel_t *color_pixels = &renderbuffer->color_buffer.pixels[y * renderbuffer->color_buffer.width + bx];
+    const vint_t ids = vf_as_bits(vf_loadu(color_pixels));
+    /* pixel centers relative to the first vertex of each triangle */
+    const vfloat_t centers = vf_add(vf_set1(bx + 0.5f), vf_lanes());
+    const float sy = y + 0.5f;
+
+    /* shade once per distinct triangle of the row */
+    vfloat_t color = vf_zero();
+    int remaining = (1 << BLOCK_SIZE) - 1;
+    while (remaining) {
+        uint32_t lane = 0;
+        while (!(remaining & (1 << lane))) lane++;
+        uint32_t id = color_pixels[lane].as_uint;
+        vfloat_t pass = vf_from_bits(vi_eq(ids, vi_set1(id)));
+        int pass_mask = vf_movemask(pass);
+        remaining &= ~pass_mask;
+
+        if (id == NUSR_RASTER_NO_TRIANGLE) {
+            color = vf_select(pass, vf_from_bits(vi_set1(clear_color)), color);
+            continue;
+        }
+
+        const nusr_triangle_t *t = &triangles[id];
+        if (id != *last_id) {
+            *last_id = id;
+            *level = select_level(t, hx + NUSR_RENDERBUFFER_HIZ_SIZE * 0.5f, hy + NUSR_RENDERBUFFER_HIZ_SIZE * 0.5f);
+        }
+
+        /* perspective correct shading */
+        vint_t texels = shade_simd(t, *level, vf_sub(centers, vf_set1(t->v0[0])), sy - t->v0[1], pass, pass_mask);
+        color = vf_select(pass, vf_from_bits(texels), color);
+    }
+    vf_storeu(color_pixels, color);
+}
+#endif
+
+nu_result_t nusr_raster_triangle(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+)
+{
+    raster_triangle(renderbuffer, triangle, NUSR_RASTER_NO_TRIANGLE, xmin, ymin, xmax, ymax);
+    return NU_SUCCESS;
+}
+nu_result_t nusr_raster_triangle_visibility(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    uint32_t id,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+)
+{
+    raster_triangle(renderbuffer, triangle, id, xmin, ymin, xmax, ymax);
+    return NU_SUCCESS;
+}
+nu_result_t nusr_raster_resolve_visibility(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangles,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    uint32_t clear_color
+)
+{
+    const uint32_t width = renderbuffer->color_buffer.width;
+    const uint32_t size = NUSR_RENDERBUFFER_HIZ_SIZE;
+    nusr_framebuffer_pixel_t *pixels = renderbuffer->color_buffer.pixels;
+
+    /* the area is aligned on coarse blocks, mip levels are selected per
+     * triangle and coarse block like the forward path */
+    for (uint32_t hy = ymin; hy < ymax; hy += size) {
+        for (uint32_t hx = xmin; hx < xmax; hx += size) {
+            uint32_t last_id = NUSR_RASTER_NO_TRIANGLE;
+            const nusr_texture_level_t *level = NULL;
+            for (uint32_t y = hy; y < NU_MIN(hy + size, ymax); y++) {
+                uint32_t x = hx;
+#if defined(NUSR_RASTER_SIMD)
+                for (; x + BLOCK_SIZE <= NU_MIN(hx + size, xmax); x += BLOCK_SIZE) {
+                    resolve_simd_block(renderbuffer, triangles, hx, hy, x, y, &last_id, &level, clear_color);
+                }
+#endif
+                /* framebuffer borders */
+                for (; x < NU_MIN(hx + size, xmax); x++) {
+                    uint32_t id = pixels[y * width + x].as_uint;
+                    if (id == NUSR_RASTER_NO_TRIANGLE) {
+                        pixels[y * width + x].as_uint = clear_color;
+                        continue;
+                    }
+                    if (id != last_id) {
+                        last_id = id;
+                        level = select_level(&triangles[id], hx + size * 0.5f, hy + size * 0.5f);
+                    }
+                    pixels[y * width + x].as_uint = shade_pixel(&triangles[id], level, x + 0.5f, y + 0.5f);
+                }
+            }
+        }
+    }
+
+    return NU_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef NUSR_SCENE_RASTER_H
+#define NUSR_SCENE_RASTER_H
+
+#include "../memory/renderbuffer.h"
+#include "../asset/texture.h"
+
+/* vertices are snapped to a 1/16 pixel grid */
+#define NUSR_RASTER_SUBPIXEL_BITS 4
+#define NUSR_RASTER_SUBPIXEL_STEP (1 << NUSR_RASTER_SUBPIXEL_BITS)
+
+/* triangles spanning less than the guard band (in pixels) use 32 bits
+ * edge stepping, blocks of larger ones are classified with 64 bits values */
+#define NUSR_RASTER_GUARD_BAND (1 << 16)
+
+/* snapped coordinates (in pixels) must stay below this value to keep 64
+ * bits edge functions from overflowing, clipping guarantees it */
+#define NUSR_RASTER_MAX_COORDINATE (1 << 24)
+
+/* visibility buffer value of pixels without triangle */
+#define NUSR_RASTER_NO_TRIANGLE 0xFFFFFFFF
+
+/* per vertex attributes interpolated with perspective correction, uvs
+ * come first and optional vertex colors follow */
+#define NUSR_RASTER_VARYING_U 0
+#define NUSR_RASTER_VARYING_V 1
+#define NUSR_RASTER_VARYING_COLOR 2
+#define NUSR_RASTER_MAX_VARYING_COUNT 5
+
+typedef struct {
+    /* viewport vertices, z is the depth in the depth buffer format */
+    nu_vec4_t v0;
+    nu_vec4_t v1;
+    nu_vec4_t v2;
+    /* fixed point edge functions (e = c + x * step_x + y * step_y) */
+    int64_t edge_c[3];
+    int64_t edge_step_x[3];
+    int64_t edge_step_y[3];
+    bool guard_band;
+    /* depth plane (z = v0.z + zx * (x - v0.x) + zy * (y - v0.y)) */
+    float zx;
+    float zy;
+    float zmin;
+    /* planes of 1 / w and varyings / w which are affine in screen space
+     * (p = p[0] + p[1] * (x - v0.x) + p[2] * (y - v0.y)), a pixel needs a
+     * single reciprocal to recover its varyings */
+    float inv_w[3];
+    float varyings[NUSR_RASTER_MAX_VARYING_COUNT][3];
+    uint32_t varying_count;
+    /* bounding box (max excluded) */
+    uint32_t xmin;
+    uint32_t ymin;
+    uint32_t xmax;
+    uint32_t ymax;
+    const nusr_texture_t *texture;
+} nusr_triangle_t;
+
+bool nusr_raster_triangle_setup(
+    nusr_triangle_t *triangle,
+    const float *varyings[3], uint32_t varying_count,
+    uint32_t width, uint32_t height
+);
+nu_result_t nusr_raster_triangle(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+);
+
+/* visibility buffer, the first pass writes depth and triangle ids in the
+ * color buffer, the resolve pass shades each pixel once */
+nu_result_t nusr_raster_triangle_visibility(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangle,
+    uint32_t id,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax
+);
+nu_result_t nusr_raster_resolve_visibility(
+    nusr_renderbuffer_t *renderbuffer,
+    const nusr_triangle_t *triangles,
+    uint32_t xmin, uint32_t ymin,
+    uint32_t xmax, uint32_t ymax,
+    uint32_t clear_color
+);
+
+#endif
\ No newline at end of file
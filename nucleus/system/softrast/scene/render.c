@@ -4,89 +4,139 @@
 #include "../asset/mesh.h"
 #include "../asset/texture.h"
 #include "../viewport/viewport.h"
-
-static void vertex_shader(nu_vec3_t pos, nu_mat4_t m, nu_vec4_t dest)
+#include "../common/config.h"
+#include "binning.h"
+#include "occlusion.h"
+#include "vertex.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+typedef struct {
+    nusr_renderbuffer_t *renderbuffer;
+    const nusr_binning_t *binning;
+    uint32_t tile;
+    /* time from the start of the frame to the end of the tile */
+    float elapsed;
+} nusr_tile_job_args_t;
+
+/* a triangle clipped by 6 planes has at most 9 vertices */
+#define MAX_CLIP_VERTEX_COUNT 9
+
+/* clipped triangles stay within a quarter of the raster guard band on
+ * both sides of the viewport, so their span keeps 32 bits edge stepping
+ * and their coordinates stay below the raster limit */
+#define GUARD_BAND_EXTENT (NUSR_RASTER_GUARD_BAND / 4)
+#if NUSR_RENDERBUFFER_MAX_SIZE + GUARD_BAND_EXTENT >= NUSR_RASTER_MAX_COORDINATE
+    #error "the guard band of the largest renderbuffer exceeds the raster coordinates"
+#endif
+
+typedef struct {
+    nu_vec4_t position;
+    float varyings[NUSR_RASTER_MAX_VARYING_COUNT];
+} nusr_clip_vertex_t;
+
+typedef struct {
+    /* depth (16 bits) | texture (8 bits) | mesh (8 bits) | submission (32 bits) */
+    uint64_t key;
+    const nusr_mesh_t *mesh;
+    const nusr_texture_t *texture;
+    nu_mat4_t mvp;
+} nusr_draw_t;
+
+typedef struct {
+    nu_task_handle_t task;
+    nusr_binning_t binning;
+    nu_task_job_t *jobs;
+    nusr_tile_job_args_t *job_args;
+    uint32_t job_capacity;
+    uint32_t job_count;
+    bool partial_redraw;
+    bool occlusion_culling;
+    bool visibility_buffer;
+    /* projected diameter in pixels below which the first simplified level
+     * is used, the threshold halves for each following level */
+    float lod_screen_size;
+    /* pixels per world unit at a view depth of 1 */
+    float lod_scale;
+    nusr_occlusion_t occlusion;
+    nusr_vertex_buffer_t vertices;
+    nusr_draw_t *draws;
+    uint32_t draw_count;
+    uint32_t draw_capacity;
+    nu_timer_t frame_timer;
+    float frame_time;
+} nusr_scene_render_data_t;
+
+static nusr_scene_render_data_t _data;
+
+static void lerp_clip_vertex(const nusr_clip_vertex_t *a, const nusr_clip_vertex_t *b, float t, uint32_t varying_count, nusr_clip_vertex_t *dest)
 {
-    /* multiply MVP */
-    nu_vec4(pos, 1.0f, dest);
-    nu_mat4_mulv(m, dest, dest);
+    nu_vec4_lerp(a->position, b->position, t, dest->position);
+    for (uint32_t k = 0; k < varying_count; k++) {
+        dest->varyings[k] = a->varyings[k] + (b->varyings[k] - a->varyings[k]) * t;
+    }
 }
-
-static void clip_edge_near(
-    nu_vec4_t v0, nu_vec4_t v1, nu_vec4_t vclip,
-    nu_vec2_t uv0, nu_vec2_t uv1, nu_vec2_t uvclip
+static uint32_t clip_polygon(
+    const nusr_clip_vertex_t *in, uint32_t count,
+    uint32_t varying_count,
+    const nu_vec4_t plane,
+    nusr_clip_vertex_t *out
 )
 {
-    const nu_vec4_t near_plane = {0, 0, 1, 1};
-    float d0 = nu_vec4_dot(v0, near_plane);
-    float d1 = nu_vec4_dot(v1, near_plane);
-    float s = d0 / (d0 - d1);
-    nu_vec4_lerp(v0, v1, s, vclip);
-    nu_vec2_lerp(uv0, uv1, s, uvclip);
+    /* Sutherland-Hodgman against one plane, inside is positive */
+    uint32_t out_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const nusr_clip_vertex_t *current = &in[i];
+        const nusr_clip_vertex_t *next = &in[(i + 1) % count];
+        float dc = nu_vec4_dot(plane, current->position);
+        float dn = nu_vec4_dot(plane, next->position);
+        if (dc >= 0.0f) out[out_count++] = *current;
+        if ((dc >= 0.0f) != (dn >= 0.0f)) {
+            lerp_clip_vertex(current, next, dc / (dc - dn), varying_count, &out[out_count++]);
+        }
+    }
+    return out_count;
 }
-static bool clip_triangle(
-    nu_vec4_t vertices[4],
-    nu_vec2_t uvs[4],
-    uint32_t indices[6],
-    uint32_t *indice_count
+static uint32_t clip_triangle(
+    nusr_clip_vertex_t vertices[MAX_CLIP_VERTEX_COUNT],
+    uint32_t varying_count,
+    uint16_t outcodes,
+    float guard_x, float guard_y
 )
 {
-    /* default triangle output */
-    *indice_count = 3;
-    indices[0] = 0;
-    indices[1] = 1;
-    indices[2] = 2;
-
-    /* compute outsides */
-    bool outside[3];
-    for (uint32_t i = 0; i < 3; i++) {
-        outside[i] = (vertices[i][3] <= 0) || (vertices[i][2] < -vertices[i][3]);
+    /* only planes crossed by the triangle are clipped */
+    const struct {
+        uint16_t outcode;
+        nu_vec4_t plane;
+    } planes[] = {
+        {NUSR_VERTEX_OUTCODE_NEAR,         {0.0f, 0.0f, 1.0f, 1.0f}},
+        {NUSR_VERTEX_OUTCODE_FAR,          {0.0f, 0.0f, -1.0f, 1.0f}},
+        {NUSR_VERTEX_OUTCODE_GUARD_LEFT,   {1.0f, 0.0f, 0.0f, guard_x}},
+        {NUSR_VERTEX_OUTCODE_GUARD_RIGHT,  {-1.0f, 0.0f, 0.0f, guard_x}},
+        {NUSR_VERTEX_OUTCODE_GUARD_BOTTOM, {0.0f, 1.0f, 0.0f, guard_y}},
+        {NUSR_VERTEX_OUTCODE_GUARD_TOP,    {0.0f, -1.0f, 0.0f, guard_y}}
+    };
+
+    nusr_clip_vertex_t buffer[MAX_CLIP_VERTEX_COUNT];
+    uint32_t count = 3;
+    for (uint32_t p = 0; p < sizeof(planes) / sizeof(planes[0]) && count >= 3; p++) {
+        if (!(outcodes & planes[p].outcode)) continue;
+        count = clip_polygon(vertices, count, varying_count, planes[p].plane, buffer);
+        memcpy(vertices, buffer, sizeof(nusr_clip_vertex_t) * count);
     }
 
-    /* early test out */
-    if ((outside[0] & outside[1] & outside[2]) != 0) return false;
-    /* early test in  */
-    if ((outside[0] | outside[1] | outside[2]) == 0) return true;
-
-    /* clip vertices */
-    for (uint32_t i = 0; i < 3; i++) {
-        float *vec, *vec_prev, *vec_next;
-        float *uv, *uv_prev, *uv_next;
-        bool out, out_prev, out_next;
-        vec = vertices[i];
-        uv = uvs[i];
-        out = outside[i];
-
-        vec_next = vertices[(i + 1) % 3];
-        uv_next = uvs[(i + 1) % 3];
-        out_next = outside[(i + 1) % 3];
-        
-        vec_prev = vertices[(i + 2) % 3];
-        uv_prev = uvs[(i + 2) % 3];
-        out_prev = outside[(i + 2) % 3];
-
-        if (out) {
-            if (out_next) { /* 2 out case 1 */
-                clip_edge_near(vec, vec_prev, vec, uv, uv_prev, uv);
-            } else if (out_prev) { /* 2 out case 2 */
-                clip_edge_near(vec, vec_next, vec, uv, uv_next, uv);
-            } else { /* 1 out */
-                /* produce new vertex */
-                clip_edge_near(vec, vec_next, vertices[3], uv, uv_next, uvs[3]);
-                *indice_count = 6;
-                indices[3] = i;
-                indices[4] = 3; /* new vertex */
-                indices[5] = (i + 1) % 3;
-
-                /* clip existing vertex */
-                clip_edge_near(vec, vec_prev, vec, uv, uv_prev, uv);
-
-                return true;
-            }
-        }
+    /* intersections are rounded and may land slightly outside the guard
+     * band, snap them back so the raster limit holds */
+    for (uint32_t i = 0; i < count; i++) {
+        float *position = vertices[i].position;
+        position[0] = NU_MIN(NU_MAX(position[0], -guard_x * position[3]), guard_x * position[3]);
+        position[1] = NU_MIN(NU_MAX(position[1], -guard_y * position[3]), guard_y * position[3]);
     }
 
-    return true;
+    return count;
 }
 static void vertex_to_viewport(nu_vec2_t v, nu_vec4_t vp)
 {
@@ -99,180 +149,591 @@ static void vertex_to_viewport(nu_vec2_t v, nu_vec4_t vp)
     nu_vec2_add(v, vp + 0, v);
 }
 
-static float pixel_coverage(const nu_vec2_t a, const nu_vec2_t b, const nu_vec2_t c)
+static void frustum_planes(const nu_mat4_t vp, nu_vec4_t planes[6])
+{
+    /* extract planes from the matrix rows (Gribb-Hartmann), inside is positive */
+    for (uint32_t i = 0; i < 3; i++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            planes[i * 2 + 0][c] = vp[c][3] + vp[c][i];
+            planes[i * 2 + 1][c] = vp[c][3] - vp[c][i];
+        }
+    }
+}
+static bool aabb_in_frustum(
+    const nu_vec4_t planes[6],
+    const nusr_mesh_t *mesh,
+    const nu_mat4_t transform
+)
+{
+    /* transform AABB center and extents to world space */
+    nu_vec4_t center = {
+        (mesh->xmin + mesh->xmax) * 0.5f,
+        (mesh->ymin + mesh->ymax) * 0.5f,
+        (mesh->zmin + mesh->zmax) * 0.5f,
+        1.0f
+    };
+    const nu_vec3_t extents = {
+        (mesh->xmax - mesh->xmin) * 0.5f,
+        (mesh->ymax - mesh->ymin) * 0.5f,
+        (mesh->zmax - mesh->zmin) * 0.5f
+    };
+    nu_vec4_t world_center;
+    nu_mat4_mulv(transform, center, world_center);
+    nu_vec3_t world_extents;
+    for (uint32_t i = 0; i < 3; i++) {
+        world_extents[i] = fabsf(transform[0][i]) * extents[0]
+            + fabsf(transform[1][i]) * extents[1]
+            + fabsf(transform[2][i]) * extents[2];
+    }
+
+    /* the box is outside when it is fully behind one plane */
+    for (uint32_t p = 0; p < 6; p++) {
+        float d = nu_vec4_dot(planes[p], world_center);
+        float r = fabsf(planes[p][0]) * world_extents[0]
+            + fabsf(planes[p][1]) * world_extents[1]
+            + fabsf(planes[p][2]) * world_extents[2];
+        if (d + r < 0.0f) return false;
+    }
+
+    return true;
+}
+
+static void view_projection(const nusr_camera_t *camera, nu_mat4_t vp)
+{
+    /* the aspect ratio is the viewport one, whatever the internal resolution */
+    uint32_t width, height;
+    nusr_viewport_get_size(&width, &height);
+    nu_mat4_t camera_projection, camera_view;
+    nu_lookat(camera->eye, camera->center, (nu_vec3_t){0.0f, 1.0f, 0.0f}, camera_view);
+    const float aspect = (double)width / (double)height;
+    nu_perspective(camera->fov, aspect, camera->near, camera->far, camera_projection);
+    nu_mat4_mul(camera_projection, camera_view, vp);
+}
+static void screen_bounds(
+    const nusr_mesh_t *mesh,
+    const nu_mat4_t mvp,
+    float width, float height,
+    int32_t bounds[4]
+)
+{
+    /* project the AABB corners, boxes behind the eye cover the screen */
+    float xmin = width, ymin = height, xmax = 0.0f, ymax = 0.0f;
+    for (uint32_t c = 0; c < 8; c++) {
+        const nu_vec4_t corner = {
+            (c & 1) ? mesh->xmax : mesh->xmin,
+            (c & 2) ? mesh->ymax : mesh->ymin,
+            (c & 4) ? mesh->zmax : mesh->zmin,
+            1.0f
+        };
+        nu_vec4_t p;
+        nu_mat4_mulv(mvp, corner, p);
+        if (p[3] <= 0.0f) {
+            xmin = ymin = 0.0f;
+            xmax = width;
+            ymax = height;
+            break;
+        }
+        float x = (p[0] / p[3] + 1.0f) * 0.5f * width;
+        float y = (p[1] / p[3] + 1.0f) * 0.5f * height;
+        xmin = NU_MIN(xmin, x);
+        ymin = NU_MIN(ymin, y);
+        xmax = NU_MAX(xmax, x);
+        ymax = NU_MAX(ymax, y);
+    }
+
+    /* one pixel margin for snapping, clamped before the conversion */
+    bounds[0] = (int32_t)floorf(NU_MAX(xmin, -1.0f)) - 1;
+    bounds[1] = (int32_t)floorf(NU_MAX(ymin, -1.0f)) - 1;
+    bounds[2] = (int32_t)ceilf(NU_MIN(xmax, width + 1.0f)) + 1;
+    bounds[3] = (int32_t)ceilf(NU_MIN(ymax, height + 1.0f)) + 1;
+}
+
+static const nusr_mesh_t *select_lod(const nusr_mesh_t *mesh, const nu_mat4_t transform, const nu_mat4_t mvp)
+{
+    if (!mesh->lod_count) return mesh;
+
+    /* bounding sphere of the AABB scaled by the largest axis */
+    const nu_vec3_t extents = {
+        (mesh->xmax - mesh->xmin) * 0.5f,
+        (mesh->ymax - mesh->ymin) * 0.5f,
+        (mesh->zmax - mesh->zmin) * 0.5f
+    };
+    float scale = 0.0f;
+    for (uint32_t i = 0; i < 3; i++) {
+        scale = NU_MAX(scale, nu_vec3_dot(transform[i], transform[i]));
+    }
+    const float radius = sqrtf(nu_vec3_dot(extents, extents) * scale);
+
+    /* view depth of the center, the eye inside the sphere keeps the mesh */
+    const nu_vec3_t center = {
+        (mesh->xmin + mesh->xmax) * 0.5f,
+        (mesh->ymin + mesh->ymax) * 0.5f,
+        (mesh->zmin + mesh->zmax) * 0.5f
+    };
+    const float depth = mvp[0][3] * center[0] + mvp[1][3] * center[1] + mvp[2][3] * center[2] + mvp[3][3];
+    if (depth <= radius) return mesh;
+
+    const float size = 2.0f * radius * _data.lod_scale / depth;
+    float threshold = _data.lod_screen_size;
+    uint32_t level = 0;
+    while (level < mesh->lod_count && size < threshold) {
+        level++;
+        threshold *= 0.5f;
+    }
+    return level ? &mesh->lods[level - 1] : mesh;
+}
+static uint64_t draw_key(uint32_t mesh_id, uint32_t texture_id, const nusr_mesh_t *mesh, const nu_mat4_t mvp, uint32_t index)
+{
+    /* view depth of the AABB center */
+    const nu_vec4_t center = {
+        (mesh->xmin + mesh->xmax) * 0.5f,
+        (mesh->ymin + mesh->ymax) * 0.5f,
+        (mesh->zmin + mesh->zmax) * 0.5f,
+        1.0f
+    };
+    float depth = mvp[0][3] * center[0] + mvp[1][3] * center[1] + mvp[2][3] * center[2] + mvp[3][3];
+    depth = NU_MAX(depth, 0.0f);
+
+    /* positive floats sort like their bits, keeping 7 mantissa bits groups
+     * draws at about the same depth so they are batched by texture and mesh */
+    uint32_t depth_bits;
+    memcpy(&depth_bits, &depth, sizeof(float));
+
+    /* the full submission index keeps keys unique so the order is stable,
+     * ids above the field widths only weaken batching */
+    return ((uint64_t)(depth_bits >> 16) << 48)
+        | ((uint64_t)(texture_id & 0xFF) << 40)
+        | ((uint64_t)(mesh_id & 0xFF) << 32)
+        | (uint64_t)index;
+}
+static int compare_draws(const void *a, const void *b)
+{
+    uint64_t ka = ((const nusr_draw_t*)a)->key;
+    uint64_t kb = ((const nusr_draw_t*)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+static void push_draw(
+    uint32_t mesh_id, const nusr_mesh_t *mesh,
+    uint32_t texture_id, const nusr_texture_t *texture,
+    const nu_mat4_t mvp
+)
+{
+    /* grow draw list */
+    if (_data.draw_count >= _data.draw_capacity) {
+        _data.draw_capacity = _data.draw_capacity ? _data.draw_capacity * 2 : 64;
+        _data.draws = (nusr_draw_t*)nu_realloc(_data.draws, sizeof(nusr_draw_t) * _data.draw_capacity);
+    }
+
+    /* the submission order breaks ties */
+    nusr_draw_t *draw = &_data.draws[_data.draw_count];
+    draw->key = draw_key(mesh_id, texture_id, mesh, mvp, _data.draw_count);
+    draw->mesh = mesh;
+    draw->texture = texture;
+    nu_mat4_copy(mvp, draw->mvp);
+    _data.draw_count++;
+}
+static void rasterize_occluder(
+    const nusr_mesh_t *mesh,
+    const nu_mat4_t transform,
+    const nu_mat4_t vp
+)
+{
+    nu_mat4_t mvp;
+    nu_mat4_mul(vp, transform, mvp);
+    nusr_vertex_buffer_transform(&_data.vertices, mesh, mvp);
+    nusr_occlusion_rasterize_mesh(&_data.occlusion, mesh, &_data.vertices);
+}
+static void push_object(
+    const nusr_renderbuffer_t *renderbuffer,
+    uint32_t mesh_id, const nusr_mesh_t *mesh,
+    uint32_t texture_id, const nusr_texture_t *texture,
+    const nu_mat4_t transform,
+    bool occluder,
+    const nu_mat4_t vp
+)
+{
+    /* compute mvp matrix */
+    nu_mat4_t mvp;
+    nu_mat4_mul(vp, transform, mvp);
+
+    /* objects outside of the tiles to redraw are skipped */
+    if (_data.partial_redraw) {
+        int32_t bounds[4];
+        screen_bounds(mesh, mvp, renderbuffer->color_buffer.width, renderbuffer->color_buffer.height, bounds);
+        if (!nusr_renderbuffer_is_area_dirty(renderbuffer, bounds[0], bounds[1], bounds[2], bounds[3])) return;
+    }
+
+    /* occlusion culling, occluders are always rendered */
+    if (_data.occlusion_culling && !occluder) {
+        if (!nusr_occlusion_test_mesh(&_data.occlusion, mesh, mvp)) return;
+    }
+
+    /* level of detail from the projected size */
+    push_draw(mesh_id, select_lod(mesh, transform, mvp), texture_id, texture, mvp);
+}
+
+static void rasterize_tile(const nusr_tile_job_args_t *job)
+{
+    const nusr_binning_t *binning = job->binning;
+    const nusr_bin_t *bin = &binning->bins[job->tile];
+
+    /* recover tile area */
+    uint32_t xmin, ymin, xmax, ymax;
+    nusr_binning_get_tile_area(binning, job->tile, &xmin, &ymin, &xmax, &ymax);
+
+    /* tiles without geometry are cleared at resolve time */
+    if (!bin->triangle_count) {
+        nusr_renderbuffer_defer_clear_area(job->renderbuffer, xmin, ymin, xmax, ymax);
+        return;
+    }
+
+    /* clear tile */
+    nusr_renderbuffer_clear_depth_area(job->renderbuffer, xmin, ymin, xmax, ymax);
+
+    /* the visibility buffer keeps a single id per pixel, multisampled
+     * renderbuffers are always shaded forward */
+    if (_data.visibility_buffer && job->renderbuffer->sample_count == 1) {
+        /* write depth and triangle ids, then shade each visible pixel once */
+        nusr_framebuffer_clear_area(&job->renderbuffer->color_buffer, xmin, ymin, xmax, ymax, NUSR_RASTER_NO_TRIANGLE);
+        for (uint32_t i = 0; i < bin->triangle_count; i++) {
+            nusr_raster_triangle_visibility(
+                job->renderbuffer,
+                &binning->triangles[bin->triangles[i]],
+                bin->triangles[i],
+                xmin, ymin, xmax, ymax
+            );
+        }
+        nusr_raster_resolve_visibility(job->renderbuffer, binning->triangles, xmin, ymin, xmax, ymax, NUSR_RENDERBUFFER_CLEAR_COLOR);
+        return;
+    }
+
+    nusr_renderbuffer_clear_color_area(job->renderbuffer, xmin, ymin, xmax, ymax, NUSR_RENDERBUFFER_CLEAR_COLOR);
+
+    /* rasterize binned triangles in submission order */
+    for (uint32_t i = 0; i < bin->triangle_count; i++) {
+        nusr_raster_triangle(
+            job->renderbuffer,
+            &binning->triangles[bin->triangles[i]],
+            xmin, ymin, xmax, ymax
+        );
+    }
+
+    /* average samples in the final tile colors */
+    if (job->renderbuffer->sample_count > 1) {
+        nusr_renderbuffer_resolve_samples_area(job->renderbuffer, xmin, ymin, xmax, ymax);
+    }
+}
+static void render_tile(void *args, uint32_t unused0, uint32_t unused1)
+{
+    /* task jobs have a fixed signature, the thread pool passes zeros */
+    (void)unused0;
+    (void)unused1;
+    nusr_tile_job_args_t *job = (nusr_tile_job_args_t*)args;
+    rasterize_tile(job);
+    job->elapsed = nu_timer_get_time_elapsed(&_data.frame_timer);
+}
+static void render_tiles(nusr_renderbuffer_t *renderbuffer)
+{
+    uint32_t tile_count = _data.binning.tile_count_x * _data.binning.tile_count_y;
+
+    /* allocate jobs */
+    if (tile_count > _data.job_capacity) {
+        _data.job_capacity = tile_count;
+        _data.jobs = (nu_task_job_t*)nu_realloc(_data.jobs, sizeof(nu_task_job_t) * tile_count);
+        _data.job_args = (nusr_tile_job_args_t*)nu_realloc(_data.job_args, sizeof(nusr_tile_job_args_t) * tile_count);
+    }
+
+    /* one job per dirty tile, each job owns its tile memory, other tiles
+     * keep the content of the last frame drawn in this renderbuffer */
+    _data.job_count = 0;
+    for (uint32_t i = 0; i < tile_count; i++) {
+        if (!renderbuffer->tile_dirty[i]) continue;
+        renderbuffer->tile_dirty[i] = false;
+        const uint32_t j = _data.job_count++;
+        _data.job_args[j].renderbuffer = renderbuffer;
+        _data.job_args[j].binning = &_data.binning;
+        _data.job_args[j].tile = i;
+        _data.job_args[j].elapsed = 0.0f;
+        _data.jobs[j].func = render_tile;
+        _data.jobs[j].args = &_data.job_args[j];
+    }
+
+    /* jobs run until nusr_scene_render_wait */
+    nu_task_perform(_data.task, _data.jobs, _data.job_count);
+}
+
+nu_result_t nusr_scene_render_initialize(void)
+{
+    nu_task_create(&_data.task);
+    nusr_binning_create(&_data.binning);
+    _data.jobs = NULL;
+    _data.job_args = NULL;
+    _data.job_capacity = 0;
+    _data.job_count = 0;
+
+    nusr_vertex_buffer_create(&_data.vertices);
+    _data.draws = NULL;
+    _data.draw_count = 0;
+    _data.draw_capacity = 0;
+    _data.frame_time = 0.0f;
+
+    /* occlusion culling */
+    nu_config_get_bool(NUSR_CONFIG_SOFTRAST_SECTION, NUSR_CONFIG_SOFTRAST_OCCLUSION_CULLING, &_data.occlusion_culling, false);
+    nusr_occlusion_create(&_data.occlusion);
+
+    /* deferred texturing */
+    nu_config_get_bool(NUSR_CONFIG_SOFTRAST_SECTION, NUSR_CONFIG_SOFTRAST_VISIBILITY_BUFFER, &_data.visibility_buffer, false);
+
+    /* levels of detail */
+    uint32_t lod_screen_size;
+    nu_config_get_uint(NUSR_CONFIG_SOFTRAST_SECTION, NUSR_CONFIG_SOFTRAST_LOD_SCREEN_SIZE, &lod_screen_size, 128);
+    _data.lod_screen_size = (float)lod_screen_size;
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_scene_render_terminate(void)
+{
+    nusr_binning_destroy(&_data.binning);
+    nusr_occlusion_destroy(&_data.occlusion);
+    nusr_vertex_buffer_destroy(&_data.vertices);
+    if (_data.draws) {
+        nu_free(_data.draws);
+    }
+    if (_data.jobs) {
+        nu_free(_data.jobs);
+        nu_free(_data.job_args);
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_scene_render_get_occlusion_counts(uint32_t *occluded, uint32_t *visible)
 {
-    return (c[0] - a[0]) * (b[1] - a[1]) - (c[1] - a[1]) * (b[0] - a[0]);
+    *occluded = _data.occlusion.occluded_count;
+    *visible = _data.occlusion.visible_count;
+
+    return NU_SUCCESS;
 }
+nu_result_t nusr_scene_render_get_frame_time(float *time)
+{
+    *time = _data.frame_time;
 
+    return NU_SUCCESS;
+}
+nu_result_t nusr_scene_render_invalidate_mesh(const nusr_camera_t *camera, uint32_t mesh_id, const nu_mat4_t transform)
+{
+    nusr_mesh_t *mesh;
+    if (nusr_mesh_get(mesh_id, &mesh) != NU_SUCCESS) return NU_FAILURE;
+
+    /* screen area covered by the mesh with the current camera */
+    nu_mat4_t vp, mvp;
+    view_projection(camera, vp);
+    nu_mat4_mul(vp, transform, mvp);
+    uint32_t width, height;
+    nusr_viewport_get_size(&width, &height);
+    int32_t bounds[4];
+    screen_bounds(mesh, mvp, width, height, bounds);
+
+    return nusr_viewport_invalidate_area(bounds[0], bounds[1], bounds[2], bounds[3]);
+}
 nu_result_t nusr_scene_render_global(
     nusr_renderbuffer_t *renderbuffer,
     const nusr_camera_t *camera,
     const nusr_staticmesh_t *staticmeshes,
-    uint32_t staticmesh_count
+    nusr_bvh_t *staticmesh_bvh,
+    const nusr_instancedmesh_t *instancedmeshes,
+    uint32_t instancedmesh_count
 )
 {
-    /* recover buffer size */
-    uint32_t width, height;
-    nusr_viewport_get_size(&width, &height);
+    /* the frame time covers the setup and the slowest tile */
+    nu_timer_start(&_data.frame_timer);
 
-    /* clear buffers */
-    nusr_framebuffer_clear(&renderbuffer->color_buffer, 0x0);
-    nusr_framebuffer_clear(&renderbuffer->depth_buffer, 0xFFFF7F7F); /* max float value */
+    /* recover buffer size, it may differ from the viewport size */
+    const uint32_t width = renderbuffer->color_buffer.width;
+    const uint32_t height = renderbuffer->color_buffer.height;
 
-    /* compute VP matrix from camera information */
-    nu_mat4_t camera_projection, camera_view, vp;
-    nu_lookat(camera->eye, camera->center, (nu_vec3_t){0.0f, 1.0f, 0.0f}, camera_view);
-    const float aspect = (double)width / (double)height;
-    nu_perspective(camera->fov, aspect, camera->near, camera->far, camera_projection);
-    nu_mat4_mul(camera_projection, camera_view, vp);
+    /* reset bins */
+    nusr_binning_reset(&_data.binning, width, height);
+
+    /* only objects touching dirty tiles are needed when some are clean */
+    _data.partial_redraw = nusr_renderbuffer_get_dirty_tile_count(renderbuffer) < renderbuffer->tile_count_x * renderbuffer->tile_count_y;
 
-    /* iterate over staticmeshes */
-    for (uint32_t i = 0; i < staticmesh_count; i++) {
-        if (!staticmeshes[i].active) continue;
+    /* compute VP matrix from camera information */
+    nu_mat4_t vp;
+    view_projection(camera, vp);
+
+    /* same focal length as the projection, in renderbuffer pixels */
+    _data.lod_scale = 0.5f * (float)height / fabsf(tanf(camera->fov * 0.5f));
+
+    /* guard band in clip space */
+    nusr_vertex_buffer_set_guard_band(&_data.vertices,
+        1.0f + 2.0f * GUARD_BAND_EXTENT / (float)width,
+        1.0f + 2.0f * GUARD_BAND_EXTENT / (float)height
+    );
+
+    /* compute frustum planes */
+    nu_vec4_t planes[6];
+    frustum_planes(vp, planes);
+
+    /* hierarchical frustum culling of staticmeshes, the visible list is
+     * shared by the occluder and draw passes */
+    nusr_bvh_query_frustum(staticmesh_bvh, planes);
+    const uint32_t *visibles = staticmesh_bvh->results;
+    const uint32_t visible_count = staticmesh_bvh->result_count;
+
+    /* rasterize occluders into the occlusion buffer */
+    nusr_occlusion_reset(&_data.occlusion);
+    if (_data.occlusion_culling) {
+        for (uint32_t v = 0; v < visible_count; v++) {
+            const nusr_staticmesh_t *staticmesh = &staticmeshes[visibles[v]];
+            if (!staticmesh->occluder) continue;
+
+            nusr_mesh_t *mesh;
+            nusr_mesh_get(staticmesh->mesh, &mesh);
+            rasterize_occluder(mesh, staticmesh->transform, vp);
+        }
+        for (uint32_t i = 0; i < instancedmesh_count; i++) {
+            if (!instancedmeshes[i].active || !instancedmeshes[i].occluder) continue;
+
+            nusr_mesh_t *mesh;
+            nusr_mesh_get(instancedmeshes[i].mesh, &mesh);
+            for (uint32_t n = 0; n < instancedmeshes[i].instance_count; n++) {
+                if (!aabb_in_frustum(planes, mesh, instancedmeshes[i].transforms[n])) continue;
+                rasterize_occluder(mesh, instancedmeshes[i].transforms[n], vp);
+            }
+        }
+    }
 
-        /* compute mvp matrix */
-        nu_mat4_t mvp;
-        nu_mat4_mul(vp, staticmeshes[i].transform, mvp);
+    /* build the draw list from visible staticmeshes */
+    _data.draw_count = 0;
+    for (uint32_t v = 0; v < visible_count; v++) {
+        const nusr_staticmesh_t *staticmesh = &staticmeshes[visibles[v]];
 
-        /* access mesh */
+        /* access mesh and texture */
         nusr_mesh_t *mesh;
-        nusr_mesh_get(staticmeshes[i].mesh, &mesh);
+        nusr_mesh_get(staticmesh->mesh, &mesh);
+        nusr_texture_t *texture;
+        nusr_texture_get(staticmesh->texture, &texture);
+
+        push_object(
+            renderbuffer,
+            staticmesh->mesh, mesh,
+            staticmesh->texture, texture,
+            staticmesh->transform, staticmesh->occluder,
+            vp
+        );
+    }
+
+    /* instances share the mesh and texture lookups */
+    for (uint32_t i = 0; i < instancedmesh_count; i++) {
+        if (!instancedmeshes[i].active) continue;
 
-        /* access texture */
+        nusr_mesh_t *mesh;
+        nusr_mesh_get(instancedmeshes[i].mesh, &mesh);
         nusr_texture_t *texture;
-        nusr_texture_get(staticmeshes[i].texture, &texture);
+        nusr_texture_get(instancedmeshes[i].texture, &texture);
+
+        for (uint32_t n = 0; n < instancedmeshes[i].instance_count; n++) {
+            if (!aabb_in_frustum(planes, mesh, instancedmeshes[i].transforms[n])) continue;
+            push_object(
+                renderbuffer,
+                instancedmeshes[i].mesh, mesh,
+                instancedmeshes[i].texture, texture,
+                instancedmeshes[i].transforms[n], instancedmeshes[i].occluder,
+                vp
+            );
+        }
+    }
+
+    /* front to back, then batched by texture and mesh */
+    qsort(_data.draws, _data.draw_count, sizeof(nusr_draw_t), compare_draws);
+
+    /* iterate over draws */
+    for (uint32_t d = 0; d < _data.draw_count; d++) {
+        const nusr_draw_t *draw = &_data.draws[d];
+        const nusr_mesh_t *mesh = draw->mesh;
+        const nusr_texture_t *texture = draw->texture;
+
+        /* vertex stage */
+        nusr_vertex_buffer_transform(&_data.vertices, mesh, draw->mvp);
+
+        /* uvs and optional vertex colors */
+        const uint32_t varying_count = mesh->colors ? NUSR_RASTER_VARYING_COLOR + 3 : NUSR_RASTER_VARYING_COLOR;
 
         /* iterate over mesh triangles */
-        for (uint32_t vi = 0; vi < mesh->vertex_count; vi += 3) {
+        for (uint32_t ii = 0; ii < mesh->index_count; ii += 3) {
+            const uint32_t *triangle_indices = mesh->indices + ii;
             nu_vec4_t viewport = {0, 0, width, height};
-            nu_vec4_t tv[4]; /* one vertice can be added for the clipping step */
-            nu_vec2_t uv[4]; /* one uv can be added for the clipping step */
-
-            /* transform vertices */
-            vertex_shader(mesh->positions[vi + 0], mvp, tv[0]);
-            vertex_shader(mesh->positions[vi + 1], mvp, tv[1]);
-            vertex_shader(mesh->positions[vi + 2], mvp, tv[2]);
-
-            /* copy uv (should be done in vertex shader) */
-            nu_vec2_copy(mesh->uvs[vi + 0], uv[0]);
-            nu_vec2_copy(mesh->uvs[vi + 1], uv[1]);
-            nu_vec2_copy(mesh->uvs[vi + 2], uv[2]);
-
-            /* clip vertices */
-            uint32_t indices[6];
-            uint32_t indice_count;
-            if (!clip_triangle(tv, uv, indices, &indice_count)) continue;
-
-            /* perspective divide (NDC) */
-            uint32_t total_vertex = (indice_count > 3) ? 4 : 3;
-            for (uint32_t i = 0; i < total_vertex; i++) {
-                nu_vec3_muls(tv[i], 1.0f / tv[i][3], tv[i]);
-            }
-            
-            for (uint32_t idx = 0; idx < indice_count; idx += 3) {
-                nu_vec4_t v0, v1, v2;
-                nu_vec2_t uv0, uv1, uv2;
 
-                /* vertices to viewport */
-                nu_vec4_copy(tv[indices[idx + 0]], v0);
-                nu_vec4_copy(tv[indices[idx + 1]], v1);
-                nu_vec4_copy(tv[indices[idx + 2]], v2);
-                vertex_to_viewport(v0, viewport);
-                vertex_to_viewport(v1, viewport);
-                vertex_to_viewport(v2, viewport);
-
-                /* copy uvs */
-                nu_vec2_copy(uv[indices[idx + 0]], uv0);
-                nu_vec2_copy(uv[indices[idx + 1]], uv1);
-                nu_vec2_copy(uv[indices[idx + 2]], uv2);
-
-                /* backface culling */
-                float area = pixel_coverage(v0, v1, v2);
-                if (area < 0) continue;
-
-                /* compute triangle viewport */
-                nu_vec4_t tvp;
-                float xmin = NU_MIN(v0[0], NU_MIN(v1[0], v2[0]));
-                float xmax = NU_MAX(v0[0], NU_MAX(v1[0], v2[0]));
-                float ymin = NU_MIN(v0[1], NU_MIN(v1[1], v2[1]));
-                float ymax = NU_MAX(v0[1], NU_MAX(v1[1], v2[1]));
-                tvp[0] = NU_MAX(0, xmin);
-                tvp[1] = NU_MAX(0, ymin);
-                tvp[2] = NU_MIN(viewport[2], xmax);
-                tvp[3] = NU_MIN(viewport[3], ymax);
-
-                /* compute edges */
-                nu_vec2_t edge0, edge1, edge2;
-                nu_vec2_sub(v2, v1, edge0);
-                nu_vec2_sub(v0, v2, edge1);
-                nu_vec2_sub(v1, v0, edge2);
-
-                /* top left rule */
-                bool t0 = (edge0[0] != 0) ? (edge0[0] > 0) : (edge0[1] > 0);
-                bool t1 = (edge1[0] != 0) ? (edge1[0] > 0) : (edge1[1] > 0);
-                bool t2 = (edge2[0] != 0) ? (edge2[0] > 0) : (edge2[1] > 0);
-
-                float inv_vw0 = 1.0f / v0[3];
-                float inv_vw1 = 1.0f / v1[3];
-                float inv_vw2 = 1.0f / v2[3];
-
-                for (uint32_t j = tvp[1]; j < tvp[3]; j++) {
-                    for (uint32_t i = tvp[0]; i < tvp[2]; i++) {
-                        nu_vec2_t sample = {i + 0.5, j + 0.5};
-
-                        float w0 = pixel_coverage(v1, v2, sample);
-                        float w1 = pixel_coverage(v2, v0, sample);
-                        float w2 = pixel_coverage(v0, v1, sample);
-                        
-                        /* check sample with top left rule */
-                        bool included = true;
-                        included &= (w0 == 0) ? t0 : (w0 > 0);
-                        included &= (w1 == 0) ? t1 : (w1 > 0);
-                        included &= (w2 == 0) ? t2 : (w2 > 0);
-
-                        if (included) {
-                            const float area_inv = 1.0f / area;
-                            w0 *= area_inv;
-                            w1 *= area_inv;
-                            w2 = 1.0f - w0 - w1;
-
-                            /* depth test */
-                            float depth = (w0 * v0[3] + w1 * v1[3] + w2 * v2[3]);
-                            if (depth < renderbuffer->depth_buffer.pixels[j * width + i].as_float) {
-                                renderbuffer->depth_buffer.pixels[j * width + i].as_float = depth;
-                                
-                                /* correct linear interpolation */
-
-                                /*     a * f_a / w_a   +   b * f_b / w_b   +  c * f_c / w_c  *
-                                 * f=-----------------------------------------------------   *
-                                 *        a / w_a      +      b / w_b      +     c / w_c     */
-                                 
-                                float a = w0 * inv_vw0;
-                                float b = w1 * inv_vw1;
-                                float c = w2 * inv_vw2;
-                                float inv_sum_abc = 1.0f / (a + b + c);
-                                a *= inv_sum_abc;
-                                b *= inv_sum_abc;
-                                c *= inv_sum_abc;
-
-                                float px = (a * uv0[0] + b * uv1[0] + c * uv2[0]) * texture->width;
-                                float py = (a * uv0[1] + b * uv1[1] + c * uv2[1]) * texture->height;
-
-                                // float px = (w0 * uv0[0] + w1 * uv1[0] + w2 * uv2[0]) * texture->width;
-                                // float py = (w0 * uv0[1] + w1 * uv1[1] + w2 * uv2[1]) * texture->height;
-
-                                uint32_t uvx = NU_MAX(0, NU_MIN(texture->width, (uint32_t)px));
-                                uint32_t uvy = NU_MAX(0, NU_MIN(texture->height, (uint32_t)py));
-
-                                uint32_t color = texture->data[uvy * texture->width + uvx];
-                                nusr_framebuffer_set_uint(&renderbuffer->color_buffer, i, height - j - 1, color);
-                            }
-                        }
+            /* trivial reject, all vertices outside the same plane */
+            const uint16_t *outcodes = _data.vertices.outcodes;
+            uint16_t outcodes_and = outcodes[triangle_indices[0]] & outcodes[triangle_indices[1]] & outcodes[triangle_indices[2]];
+            uint16_t outcodes_or = outcodes[triangle_indices[0]] | outcodes[triangle_indices[1]] | outcodes[triangle_indices[2]];
+            if (outcodes_and) continue;
+
+            /* fetch transformed vertices and varyings (should be done in vertex shader) */
+            nusr_clip_vertex_t vertices[MAX_CLIP_VERTEX_COUNT];
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint32_t index = triangle_indices[k];
+                nusr_vertex_buffer_get(&_data.vertices, index, vertices[k].position);
+                vertices[k].varyings[NUSR_RASTER_VARYING_U] = mesh->uvs[index][0];
+                vertices[k].varyings[NUSR_RASTER_VARYING_V] = mesh->uvs[index][1];
+                if (mesh->colors) {
+                    for (uint32_t c = 0; c < 3; c++) {
+                        vertices[k].varyings[NUSR_RASTER_VARYING_COLOR + c] = mesh->colors[index][c];
                     }
                 }
             }
+
+            /* triangles inside the guard band skip clipping */
+            uint32_t vertex_count = 3;
+            if (outcodes_or & NUSR_VERTEX_OUTCODE_CLIP) {
+                vertex_count = clip_triangle(vertices, varying_count, outcodes_or, _data.vertices.guard_x, _data.vertices.guard_y);
+                if (vertex_count < 3) continue;
+            }
+
+            /* perspective divide (NDC), z is converted to the depth buffer format */
+            for (uint32_t i = 0; i < vertex_count; i++) {
+                float *position = vertices[i].position;
+                nu_vec3_muls(position, 1.0f / position[3], position);
+                position[2] = nusr_renderbuffer_depth_value(renderbuffer, position[2], position[3], camera->near, camera->far);
+            }
+
+            /* triangle fan */
+            for (uint32_t i = 1; i + 1 < vertex_count; i++) {
+                nusr_triangle_t triangle;
+
+                /* vertices to viewport */
+                nu_vec4_copy(vertices[0].position, triangle.v0);
+                nu_vec4_copy(vertices[i].position, triangle.v1);
+                nu_vec4_copy(vertices[i + 1].position, triangle.v2);
+                vertex_to_viewport(triangle.v0, viewport);
+                vertex_to_viewport(triangle.v1, viewport);
+                vertex_to_viewport(triangle.v2, viewport);
+
+                triangle.texture = texture;
+
+                /* setup and bin triangle */
+                const float *varyings[3] = {vertices[0].varyings, vertices[i].varyings, vertices[i + 1].varyings};
+                if (!nusr_raster_triangle_setup(&triangle, varyings, varying_count, width, height)) continue;
+                nusr_binning_push_triangle(&_data.binning, &triangle);
+            }
         }
     }
 
+    /* rasterize tiles in parallel */
+    _data.frame_time = nu_timer_get_time_elapsed(&_data.frame_timer);
+    render_tiles(renderbuffer);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_scene_render_wait(void)
+{
+    nu_task_wait(_data.task);
+
+    /* tiles finish in any order, the setup time is the lower bound */
+    for (uint32_t i = 0; i < _data.job_count; i++) {
+        _data.frame_time = NU_MAX(_data.frame_time, _data.job_args[i].elapsed);
+    }
+
     return NU_SUCCESS;
 }
\ No newline at end of file
@@ -3,11 +3,19 @@
 
 #include "scene.h"
 
+nu_result_t nusr_scene_render_initialize(void);
+nu_result_t nusr_scene_render_terminate(void);
+nu_result_t nusr_scene_render_get_occlusion_counts(uint32_t *occluded, uint32_t *visible);
+nu_result_t nusr_scene_render_get_frame_time(float *time);
+nu_result_t nusr_scene_render_invalidate_mesh(const nusr_camera_t *camera, uint32_t mesh, const nu_mat4_t transform);
 NU_API nu_result_t nusr_scene_render_global(
     nusr_renderbuffer_t *renderbuffer,
     const nusr_camera_t *camera,
     const nusr_staticmesh_t *staticmeshes,
-    uint32_t staticmesh_count
+    nusr_bvh_t *staticmesh_bvh,
+    const nusr_instancedmesh_t *instancedmeshes,
+    uint32_t instancedmesh_count
 );
+nu_result_t nusr_scene_render_wait(void);
 
 #endif
\ No newline at end of file
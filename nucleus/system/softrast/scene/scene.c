@@ -1,13 +1,27 @@
 #include "scene.h"
 
 #include "render.h"
+#include "../asset/mesh.h"
+#include "../viewport/viewport.h"
 
-#define MAX_STATICMESH_COUNT 1024
+#include <math.h>
+
+#define DEFAULT_STATICMESH_CAPACITY 64
+#define MAX_INSTANCEDMESH_COUNT 256
+/* larger instance updates redraw the whole viewport */
+#define MAX_INVALIDATED_INSTANCE_COUNT 64
 
 typedef struct {
     nusr_camera_t camera;
     uint32_t staticmesh_count;
+    uint32_t staticmesh_capacity;
     nusr_staticmesh_t *staticmeshes;
+    /* ids of destroyed staticmeshes, reused first */
+    uint32_t *free_staticmeshes;
+    uint32_t free_staticmesh_count;
+    nusr_bvh_t staticmesh_bvh;
+    uint32_t instancedmesh_count;
+    nusr_instancedmesh_t *instancedmeshes;
 } nusr_scene_data_t;
 
 static nusr_scene_data_t _data;
@@ -24,16 +38,36 @@ nu_result_t nusr_scene_initialize(void)
 
     /* staticmesh */
     _data.staticmesh_count = 0;
-    _data.staticmeshes = (nusr_staticmesh_t*)nu_malloc(sizeof(nusr_staticmesh_t) * MAX_STATICMESH_COUNT);
-    for (uint32_t i = 0; i < MAX_STATICMESH_COUNT; i++) {
-        _data.staticmeshes[i].active = false;
+    _data.staticmesh_capacity = DEFAULT_STATICMESH_CAPACITY;
+    _data.staticmeshes = (nusr_staticmesh_t*)nu_malloc(sizeof(nusr_staticmesh_t) * DEFAULT_STATICMESH_CAPACITY);
+    _data.free_staticmeshes = (uint32_t*)nu_malloc(sizeof(uint32_t) * DEFAULT_STATICMESH_CAPACITY);
+    _data.free_staticmesh_count = 0;
+    nusr_bvh_create(&_data.staticmesh_bvh);
+
+    /* instancedmesh */
+    _data.instancedmesh_count = 0;
+    _data.instancedmeshes = (nusr_instancedmesh_t*)nu_malloc(sizeof(nusr_instancedmesh_t) * MAX_INSTANCEDMESH_COUNT);
+    for (uint32_t i = 0; i < MAX_INSTANCEDMESH_COUNT; i++) {
+        _data.instancedmeshes[i].active = false;
     }
 
+    /* renderer */
+    nusr_scene_render_initialize();
+
     return NU_SUCCESS;
 }
 nu_result_t nusr_scene_terminate(void)
 {
+    nusr_scene_render_terminate();
+    nusr_bvh_destroy(&_data.staticmesh_bvh);
+    nu_free(_data.free_staticmeshes);
     nu_free(_data.staticmeshes);
+    for (uint32_t i = 0; i < _data.instancedmesh_count; i++) {
+        if (_data.instancedmeshes[i].active) {
+            nu_free(_data.instancedmeshes[i].transforms);
+        }
+    }
+    nu_free(_data.instancedmeshes);
 
     return NU_SUCCESS;
 }
@@ -42,24 +76,88 @@ nu_result_t nusr_scene_render(nusr_renderbuffer_t *renderbuffer)
     nusr_scene_render_global(
         renderbuffer,
         &_data.camera,
-        _data.staticmeshes, _data.staticmesh_count
+        _data.staticmeshes, &_data.staticmesh_bvh,
+        _data.instancedmeshes, _data.instancedmesh_count
     );
 
     return NU_SUCCESS;
 }
+nu_result_t nusr_scene_wait(void)
+{
+    /* the renderbuffer is complete once tile jobs are done */
+    return nusr_scene_render_wait();
+}
+nu_result_t nusr_scene_get_frame_time(float *time)
+{
+    /* rasterization time of the last completed frame in milliseconds */
+    return nusr_scene_render_get_frame_time(time);
+}
+
+static nu_result_t staticmesh_box(uint32_t mesh_id, const nu_mat4_t transform, nusr_aabb_t *box)
+{
+    nusr_mesh_t *mesh;
+    if (nusr_mesh_get(mesh_id, &mesh) != NU_SUCCESS) return NU_FAILURE;
+
+    const nusr_aabb_t local = {
+        {mesh->xmin, mesh->ymin, mesh->zmin},
+        {mesh->xmax, mesh->ymax, mesh->zmax}
+    };
+    nusr_aabb_transform(&local, transform, box);
+
+    return NU_SUCCESS;
+}
+static bool ray_triangle(
+    const nu_vec3_t origin, const nu_vec3_t direction,
+    const nu_vec3_t p0, const nu_vec3_t p1, const nu_vec3_t p2,
+    float *distance
+)
+{
+    /* Moller-Trumbore, both faces are hit */
+    nu_vec3_t e1, e2, p, q, s;
+    nu_vec3_sub(p1, p0, e1);
+    nu_vec3_sub(p2, p0, e2);
+    nu_vec3_cross(direction, e2, p);
+    float det = nu_vec3_dot(e1, p);
+    if (fabsf(det) < 1e-8f) return false;
+    float inv_det = 1.0f / det;
+
+    nu_vec3_sub(origin, p0, s);
+    float u = nu_vec3_dot(s, p) * inv_det;
+    if (u < 0.0f || u > 1.0f) return false;
+    nu_vec3_cross(s, e1, q);
+    float v = nu_vec3_dot(direction, q) * inv_det;
+    if (v < 0.0f || u + v > 1.0f) return false;
+
+    *distance = nu_vec3_dot(e2, q) * inv_det;
+    return *distance >= 0.0f;
+}
+static void invalidate_instancedmesh(const nusr_instancedmesh_t *instancedmesh)
+{
+    if (instancedmesh->instance_count > MAX_INVALIDATED_INSTANCE_COUNT) {
+        nusr_viewport_invalidate();
+        return;
+    }
+    for (uint32_t i = 0; i < instancedmesh->instance_count; i++) {
+        nusr_scene_render_invalidate_mesh(&_data.camera, instancedmesh->mesh, instancedmesh->transforms[i]);
+    }
+}
 
 nu_result_t nusr_scene_camera_set_fov(nu_renderer_camera_handle_t handle, float fov)
 {
+    /* camera changes redraw the whole viewport */
+    if (fov != _data.camera.fov) nusr_viewport_invalidate();
     _data.camera.fov = fov;
     return NU_SUCCESS;
 }
 nu_result_t nusr_scene_camera_set_eye(nu_renderer_camera_handle_t handle, const nu_vec3_t eye)
 {
+    if (memcmp(eye, _data.camera.eye, sizeof(nu_vec3_t))) nusr_viewport_invalidate();
     nu_vec3_copy(eye, _data.camera.eye);
     return NU_SUCCESS;
 }
 nu_result_t nusr_scene_camera_set_center(nu_renderer_camera_handle_t handle, const nu_vec3_t center)
 {
+    if (memcmp(center, _data.camera.center, sizeof(nu_vec3_t))) nusr_viewport_invalidate();
     nu_vec3_copy(center, _data.camera.center);
     return NU_SUCCESS;
 }
@@ -74,16 +172,19 @@ nu_result_t nusr_scene_camera_set_transform(const nu_mat4_t transform)
 
 nu_result_t nusr_scene_staticmesh_create(nu_renderer_staticmesh_handle_t *handle, const nu_renderer_staticmesh_create_info_t *info)
 {
-    uint32_t found_id = MAX_STATICMESH_COUNT;
-    for (uint32_t i = 0; i < _data.staticmesh_count; i++) {
-        if (!_data.staticmeshes[i].active) {
-            found_id = i;
-            break;
-        }
-    }
+    nusr_aabb_t box;
+    if (!staticmesh_box((uint64_t)info->mesh, info->transform, &box)) return NU_FAILURE;
 
-    if (found_id == MAX_STATICMESH_COUNT) {
-        if (_data.staticmesh_count >= MAX_STATICMESH_COUNT) return NU_FAILURE;
+    /* reuse a destroyed id or grow the array */
+    uint32_t found_id;
+    if (_data.free_staticmesh_count) {
+        found_id = _data.free_staticmeshes[--_data.free_staticmesh_count];
+    } else {
+        if (_data.staticmesh_count >= _data.staticmesh_capacity) {
+            _data.staticmesh_capacity *= 2;
+            _data.staticmeshes = (nusr_staticmesh_t*)nu_realloc(_data.staticmeshes, sizeof(nusr_staticmesh_t) * _data.staticmesh_capacity);
+            _data.free_staticmeshes = (uint32_t*)nu_realloc(_data.free_staticmeshes, sizeof(uint32_t) * _data.staticmesh_capacity);
+        }
         found_id = _data.staticmesh_count;
         _data.staticmesh_count++;
     }
@@ -91,7 +192,10 @@ nu_result_t nusr_scene_staticmesh_create(nu_renderer_staticmesh_handle_t *handle
     _data.staticmeshes[found_id].active = true;
     _data.staticmeshes[found_id].mesh = (uint64_t)info->mesh;
     _data.staticmeshes[found_id].texture = (uint64_t)info->texture;
+    _data.staticmeshes[found_id].occluder = info->occluder;
     nu_mat4_copy(info->transform, _data.staticmeshes[found_id].transform);
+    _data.staticmeshes[found_id].leaf = nusr_bvh_insert(&_data.staticmesh_bvh, &box, found_id);
+    nusr_scene_render_invalidate_mesh(&_data.camera, _data.staticmeshes[found_id].mesh, _data.staticmeshes[found_id].transform);
 
     *((uint64_t*)handle) = found_id;
 
@@ -101,9 +205,12 @@ nu_result_t nusr_scene_staticmesh_destroy(nu_renderer_staticmesh_handle_t handle
 {
     uint32_t id = (uint64_t)handle;
 
-    if (!_data.staticmeshes[id].active) return NU_FAILURE;
+    if (id >= _data.staticmesh_count || !_data.staticmeshes[id].active) return NU_FAILURE;
 
+    nusr_scene_render_invalidate_mesh(&_data.camera, _data.staticmeshes[id].mesh, _data.staticmeshes[id].transform);
+    nusr_bvh_remove(&_data.staticmesh_bvh, _data.staticmeshes[id].leaf);
     _data.staticmeshes[id].active = false;
+    _data.free_staticmeshes[_data.free_staticmesh_count++] = id;
 
     return NU_SUCCESS;
 }
@@ -111,9 +218,137 @@ nu_result_t nusr_scene_staticmesh_set_transform(nu_renderer_staticmesh_handle_t
 {
     uint32_t id = (uint64_t)handle;
 
-    if (!_data.staticmeshes[id].active) return NU_FAILURE;
+    if (id >= _data.staticmesh_count || !_data.staticmeshes[id].active) return NU_FAILURE;
+    if (!memcmp(m, _data.staticmeshes[id].transform, sizeof(nu_mat4_t))) return NU_SUCCESS;
+
+    /* redraw the areas covered before and after the move */
+    nusr_staticmesh_t *staticmesh = &_data.staticmeshes[id];
+    nusr_scene_render_invalidate_mesh(&_data.camera, staticmesh->mesh, staticmesh->transform);
+    nu_mat4_copy(m, staticmesh->transform);
+    nusr_scene_render_invalidate_mesh(&_data.camera, staticmesh->mesh, staticmesh->transform);
 
-    nu_mat4_copy(m, _data.staticmeshes[id].transform);
+    /* refit the bvh */
+    nusr_aabb_t box;
+    if (!staticmesh_box(staticmesh->mesh, staticmesh->transform, &box)) return NU_FAILURE;
+    nusr_bvh_update(&_data.staticmesh_bvh, staticmesh->leaf, &box);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_scene_staticmesh_query_ray(const nu_vec3_t origin, const nu_vec3_t direction, float max_distance, bool *hit, nu_renderer_ray_hit_t *result)
+{
+    *hit = false;
+
+    /* distances are measured along the normalized direction */
+    nu_vec3_t dir;
+    nu_vec3_copy(direction, dir);
+    if (nu_vec3_dot(dir, dir) == 0.0f) return NU_FAILURE;
+    nu_vec3_normalize(dir);
+
+    /* candidates come from the bvh, triangles are tested in world space */
+    nusr_bvh_query_ray(&_data.staticmesh_bvh, origin, dir, max_distance);
+    float best = max_distance;
+    for (uint32_t i = 0; i < _data.staticmesh_bvh.result_count; i++) {
+        if (_data.staticmesh_bvh.distances[i] > best) continue;
+
+        const uint32_t id = _data.staticmesh_bvh.results[i];
+        const nusr_staticmesh_t *staticmesh = &_data.staticmeshes[id];
+        nusr_mesh_t *mesh;
+        if (nusr_mesh_get(staticmesh->mesh, &mesh) != NU_SUCCESS) continue;
+        for (uint32_t ii = 0; ii < mesh->index_count; ii += 3) {
+            nu_vec3_t p[3];
+            for (uint32_t k = 0; k < 3; k++) {
+                nu_mat4_mulv3(staticmesh->transform, mesh->positions[mesh->indices[ii + k]], 1.0f, p[k]);
+            }
+            float distance;
+            if (ray_triangle(origin, dir, p[0], p[1], p[2], &distance) && distance <= best) {
+                best = distance;
+                *hit = true;
+                result->staticmesh = (nu_renderer_staticmesh_handle_t)(uint64_t)id;
+            }
+        }
+    }
+
+    if (*hit) {
+        result->distance = best;
+        nu_vec3_muls(dir, best, result->position);
+        nu_vec3_add(origin, result->position, result->position);
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_scene_staticmesh_query_aabb(const nu_vec3_t min, const nu_vec3_t max, nu_renderer_staticmesh_handle_t *handles, uint32_t capacity, uint32_t *count)
+{
+    /* count is the number of overlapping staticmeshes, only the first
+     * capacity handles are written */
+    nusr_aabb_t box;
+    nu_vec3_copy(min, box.min);
+    nu_vec3_copy(max, box.max);
+    nusr_bvh_query_aabb(&_data.staticmesh_bvh, &box);
+
+    *count = _data.staticmesh_bvh.result_count;
+    for (uint32_t i = 0; i < NU_MIN(*count, capacity); i++) {
+        handles[i] = (nu_renderer_staticmesh_handle_t)(uint64_t)_data.staticmesh_bvh.results[i];
+    }
+
+    return NU_SUCCESS;
+}
+
+nu_result_t nusr_scene_instancedmesh_create(nu_renderer_instancedmesh_handle_t *handle, const nu_renderer_instancedmesh_create_info_t *info)
+{
+    uint32_t found_id = MAX_INSTANCEDMESH_COUNT;
+    for (uint32_t i = 0; i < _data.instancedmesh_count; i++) {
+        if (!_data.instancedmeshes[i].active) {
+            found_id = i;
+            break;
+        }
+    }
+
+    if (found_id == MAX_INSTANCEDMESH_COUNT) {
+        if (_data.instancedmesh_count >= MAX_INSTANCEDMESH_COUNT) return NU_FAILURE;
+        found_id = _data.instancedmesh_count;
+        _data.instancedmesh_count++;
+    }
+
+    nusr_instancedmesh_t *instancedmesh = &_data.instancedmeshes[found_id];
+    instancedmesh->active = true;
+    instancedmesh->mesh = (uint64_t)info->mesh;
+    instancedmesh->texture = (uint64_t)info->texture;
+    instancedmesh->occluder = info->occluder;
+    instancedmesh->transforms = NULL;
+    instancedmesh->instance_count = 0;
+    nusr_scene_instancedmesh_set_transforms((nu_renderer_instancedmesh_handle_t)(uint64_t)found_id, info->transforms, info->instance_count);
+
+    *((uint64_t*)handle) = found_id;
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_scene_instancedmesh_destroy(nu_renderer_instancedmesh_handle_t handle)
+{
+    uint32_t id = (uint64_t)handle;
+
+    if (id >= _data.instancedmesh_count || !_data.instancedmeshes[id].active) return NU_FAILURE;
+
+    invalidate_instancedmesh(&_data.instancedmeshes[id]);
+    nu_free(_data.instancedmeshes[id].transforms);
+    _data.instancedmeshes[id].active = false;
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_scene_instancedmesh_set_transforms(nu_renderer_instancedmesh_handle_t handle, const nu_mat4_t *transforms, uint32_t count)
+{
+    uint32_t id = (uint64_t)handle;
+
+    if (id >= _data.instancedmesh_count || !_data.instancedmeshes[id].active) return NU_FAILURE;
+
+    /* transforms are copied, the instance count may change */
+    nusr_instancedmesh_t *instancedmesh = &_data.instancedmeshes[id];
+    invalidate_instancedmesh(instancedmesh);
+    if (count != instancedmesh->instance_count) {
+        instancedmesh->transforms = (nu_mat4_t*)nu_realloc(instancedmesh->transforms, sizeof(nu_mat4_t) * NU_MAX(count, 1));
+        instancedmesh->instance_count = count;
+    }
+    memcpy(instancedmesh->transforms, transforms, sizeof(nu_mat4_t) * count);
+    invalidate_instancedmesh(instancedmesh);
 
     return NU_SUCCESS;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "../memory/renderbuffer.h"
 #include "../module/interface.h"
+#include "bvh.h"
 
 typedef struct {
     nu_vec3_t eye;
@@ -17,12 +18,26 @@ typedef struct {
     uint32_t mesh;
     uint32_t texture;
     nu_mat4_t transform;
+    /* bvh leaf of the world bounding box */
+    uint32_t leaf;
+    bool occluder;
     bool active;
 } nusr_staticmesh_t;
 
+typedef struct {
+    uint32_t mesh;
+    uint32_t texture;
+    nu_mat4_t *transforms;
+    uint32_t instance_count;
+    bool occluder;
+    bool active;
+} nusr_instancedmesh_t;
+
 nu_result_t nusr_scene_initialize(void);
 nu_result_t nusr_scene_terminate(void);
 nu_result_t nusr_scene_render(nusr_renderbuffer_t *renderbuffer);
+nu_result_t nusr_scene_wait(void);
+nu_result_t nusr_scene_get_frame_time(float *time);
 
 nu_result_t nusr_scene_camera_set_fov(nu_renderer_camera_handle_t handle, float fov);
 nu_result_t nusr_scene_camera_set_eye(nu_renderer_camera_handle_t handle, const nu_vec3_t eye);
@@ -32,5 +47,11 @@ nu_result_t nusr_scene_camera_set_transform(const nu_mat4_t transform);
 nu_result_t nusr_scene_staticmesh_create(nu_renderer_staticmesh_handle_t *handle, const nu_renderer_staticmesh_create_info_t *info);
 nu_result_t nusr_scene_staticmesh_destroy(nu_renderer_staticmesh_handle_t handle);
 nu_result_t nusr_scene_staticmesh_set_transform(nu_renderer_staticmesh_handle_t handle, const nu_mat4_t m);
+nu_result_t nusr_scene_staticmesh_query_ray(const nu_vec3_t origin, const nu_vec3_t direction, float max_distance, bool *hit, nu_renderer_ray_hit_t *result);
+nu_result_t nusr_scene_staticmesh_query_aabb(const nu_vec3_t min, const nu_vec3_t max, nu_renderer_staticmesh_handle_t *handles, uint32_t capacity, uint32_t *count);
+
+nu_result_t nusr_scene_instancedmesh_create(nu_renderer_instancedmesh_handle_t *handle, const nu_renderer_instancedmesh_create_info_t *info);
+nu_result_t nusr_scene_instancedmesh_destroy(nu_renderer_instancedmesh_handle_t handle);
+nu_result_t nusr_scene_instancedmesh_set_transforms(nu_renderer_instancedmesh_handle_t handle, const nu_mat4_t *transforms, uint32_t count);
 
 #endif
\ No newline at end of file
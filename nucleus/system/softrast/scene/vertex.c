@@ -0,0 +1,177 @@
+#include "vertex.h"
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+    #define NUSR_VERTEX_SSE2
+#endif
+
+#define DEFAULT_VERTEX_CAPACITY 1024
+
+static void allocate_buffer(nusr_vertex_buffer_t *self, uint32_t capacity)
+{
+    self->capacity = capacity;
+    self->x = (float*)nu_realloc(self->x, sizeof(float) * self->capacity);
+    self->y = (float*)nu_realloc(self->y, sizeof(float) * self->capacity);
+    self->z = (float*)nu_realloc(self->z, sizeof(float) * self->capacity);
+    self->w = (float*)nu_realloc(self->w, sizeof(float) * self->capacity);
+    self->outcodes = (uint16_t*)nu_realloc(self->outcodes, sizeof(uint16_t) * self->capacity);
+}
+
+static uint16_t compute_outcode(const nusr_vertex_buffer_t *self, float x, float y, float z, float w)
+{
+    uint16_t outcode = 0;
+    if (x < -w) outcode |= NUSR_VERTEX_OUTCODE_LEFT;
+    if (x > w) outcode |= NUSR_VERTEX_OUTCODE_RIGHT;
+    if (y < -w) outcode |= NUSR_VERTEX_OUTCODE_BOTTOM;
+    if (y > w) outcode |= NUSR_VERTEX_OUTCODE_TOP;
+    if (w <= 0.0f || z < -w) outcode |= NUSR_VERTEX_OUTCODE_NEAR;
+    if (z > w) outcode |= NUSR_VERTEX_OUTCODE_FAR;
+    if (x < -self->guard_x * w) outcode |= NUSR_VERTEX_OUTCODE_GUARD_LEFT;
+    if (x > self->guard_x * w) outcode |= NUSR_VERTEX_OUTCODE_GUARD_RIGHT;
+    if (y < -self->guard_y * w) outcode |= NUSR_VERTEX_OUTCODE_GUARD_BOTTOM;
+    if (y > self->guard_y * w) outcode |= NUSR_VERTEX_OUTCODE_GUARD_TOP;
+    return outcode;
+}
+static void transform_scalar(nusr_vertex_buffer_t *self, const nusr_mesh_t *mesh, const nu_mat4_t m, uint32_t from)
+{
+    for (uint32_t i = from; i < mesh->vertex_count; i++) {
+        const float *p = mesh->positions[i];
+        float x = m[0][0] * p[0] + m[1][0] * p[1] + m[2][0] * p[2] + m[3][0];
+        float y = m[0][1] * p[0] + m[1][1] * p[1] + m[2][1] * p[2] + m[3][1];
+        float z = m[0][2] * p[0] + m[1][2] * p[1] + m[2][2] * p[2] + m[3][2];
+        float w = m[0][3] * p[0] + m[1][3] * p[1] + m[2][3] * p[2] + m[3][3];
+        self->x[i] = x;
+        self->y[i] = y;
+        self->z[i] = z;
+        self->w[i] = w;
+        self->outcodes[i] = compute_outcode(self, x, y, z, w);
+    }
+}
+#if defined(NUSR_VERTEX_SSE2)
+static uint32_t transform_sse2(nusr_vertex_buffer_t *self, const nusr_mesh_t *mesh, const nu_mat4_t m)
+{
+    /* broadcast matrix */
+    __m128 mm[4][4];
+    for (uint32_t c = 0; c < 4; c++) {
+        for (uint32_t r = 0; r < 4; r++) {
+            mm[c][r] = _mm_set1_ps(m[c][r]);
+        }
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 guard_x = _mm_set1_ps(self->guard_x);
+    const __m128 guard_y = _mm_set1_ps(self->guard_y);
+
+    /* four vertices per iteration */
+    uint32_t count = mesh->vertex_count & ~3u;
+    for (uint32_t i = 0; i < count; i += 4) {
+        const nu_vec3_t *p = mesh->positions + i;
+
+        /* AoS to SoA */
+        __m128 px = _mm_setr_ps(p[0][0], p[1][0], p[2][0], p[3][0]);
+        __m128 py = _mm_setr_ps(p[0][1], p[1][1], p[2][1], p[3][1]);
+        __m128 pz = _mm_setr_ps(p[0][2], p[1][2], p[2][2], p[3][2]);
+
+        /* multiply MVP */
+        __m128 v[4];
+        for (uint32_t r = 0; r < 4; r++) {
+            v[r] = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(mm[0][r], px), _mm_mul_ps(mm[1][r], py)),
+                _mm_add_ps(_mm_mul_ps(mm[2][r], pz), mm[3][r])
+            );
+        }
+        _mm_storeu_ps(self->x + i, v[0]);
+        _mm_storeu_ps(self->y + i, v[1]);
+        _mm_storeu_ps(self->z + i, v[2]);
+        _mm_storeu_ps(self->w + i, v[3]);
+
+        /* outcodes, one movemask per plane */
+        __m128 neg_w = _mm_xor_ps(v[3], sign);
+        int left   = _mm_movemask_ps(_mm_cmplt_ps(v[0], neg_w));
+        int right  = _mm_movemask_ps(_mm_cmpgt_ps(v[0], v[3]));
+        int bottom = _mm_movemask_ps(_mm_cmplt_ps(v[1], neg_w));
+        int top    = _mm_movemask_ps(_mm_cmpgt_ps(v[1], v[3]));
+        int near   = _mm_movemask_ps(_mm_or_ps(_mm_cmple_ps(v[3], zero), _mm_cmplt_ps(v[2], neg_w)));
+        int far    = _mm_movemask_ps(_mm_cmpgt_ps(v[2], v[3]));
+        __m128 guard_w_x = _mm_mul_ps(guard_x, v[3]);
+        __m128 guard_w_y = _mm_mul_ps(guard_y, v[3]);
+        int guard_left   = _mm_movemask_ps(_mm_cmplt_ps(v[0], _mm_xor_ps(guard_w_x, sign)));
+        int guard_right  = _mm_movemask_ps(_mm_cmpgt_ps(v[0], guard_w_x));
+        int guard_bottom = _mm_movemask_ps(_mm_cmplt_ps(v[1], _mm_xor_ps(guard_w_y, sign)));
+        int guard_top    = _mm_movemask_ps(_mm_cmpgt_ps(v[1], guard_w_y));
+        for (uint32_t l = 0; l < 4; l++) {
+            self->outcodes[i + l] = (uint16_t)(
+                (((left >> l) & 1) * NUSR_VERTEX_OUTCODE_LEFT)
+                | (((right >> l) & 1) * NUSR_VERTEX_OUTCODE_RIGHT)
+                | (((bottom >> l) & 1) * NUSR_VERTEX_OUTCODE_BOTTOM)
+                | (((top >> l) & 1) * NUSR_VERTEX_OUTCODE_TOP)
+                | (((near >> l) & 1) * NUSR_VERTEX_OUTCODE_NEAR)
+                | (((far >> l) & 1) * NUSR_VERTEX_OUTCODE_FAR)
+                | (((guard_left >> l) & 1) * NUSR_VERTEX_OUTCODE_GUARD_LEFT)
+                | (((guard_right >> l) & 1) * NUSR_VERTEX_OUTCODE_GUARD_RIGHT)
+                | (((guard_bottom >> l) & 1) * NUSR_VERTEX_OUTCODE_GUARD_BOTTOM)
+                | (((guard_top >> l) & 1) * NUSR_VERTEX_OUTCODE_GUARD_TOP)
+            );
+        }
+    }
+
+    return count;
+}
+#endif
+
+nu_result_t nusr_vertex_buffer_create(nusr_vertex_buffer_t *self)
+{
+    self->x = NULL;
+    self->y = NULL;
+    self->z = NULL;
+    self->w = NULL;
+    self->outcodes = NULL;
+    self->guard_x = 1.0f;
+    self->guard_y = 1.0f;
+    self->count = 0;
+    allocate_buffer(self, DEFAULT_VERTEX_CAPACITY);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_vertex_buffer_destroy(nusr_vertex_buffer_t *self)
+{
+    nu_free(self->x);
+    nu_free(self->y);
+    nu_free(self->z);
+    nu_free(self->w);
+    nu_free(self->outcodes);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_vertex_buffer_set_guard_band(nusr_vertex_buffer_t *self, float guard_x, float guard_y)
+{
+    self->guard_x = guard_x;
+    self->guard_y = guard_y;
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_vertex_buffer_transform(nusr_vertex_buffer_t *self, const nusr_mesh_t *mesh, const nu_mat4_t mvp)
+{
+    /* grow buffer */
+    if (mesh->vertex_count > self->capacity) {
+        allocate_buffer(self, mesh->vertex_count);
+    }
+    self->count = mesh->vertex_count;
+
+    /* each unique vertex is transformed once per draw */
+    uint32_t from = 0;
+#if defined(NUSR_VERTEX_SSE2)
+    from = transform_sse2(self, mesh, mvp);
+#endif
+    transform_scalar(self, mesh, mvp, from);
+
+    return NU_SUCCESS;
+}
+void nusr_vertex_buffer_get(const nusr_vertex_buffer_t *self, uint32_t i, nu_vec4_t v)
+{
+    v[0] = self->x[i];
+    v[1] = self->y[i];
+    v[2] = self->z[i];
+    v[3] = self->w[i];
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef NUSR_SCENE_VERTEX_H
+#define NUSR_SCENE_VERTEX_H
+
+#include "../asset/mesh.h"
+
+/* clip outcodes, near also flags vertices behind the eye */
+#define NUSR_VERTEX_OUTCODE_LEFT   0x01
+#define NUSR_VERTEX_OUTCODE_RIGHT  0x02
+#define NUSR_VERTEX_OUTCODE_BOTTOM 0x04
+#define NUSR_VERTEX_OUTCODE_TOP    0x08
+#define NUSR_VERTEX_OUTCODE_NEAR   0x10
+#define NUSR_VERTEX_OUTCODE_FAR    0x20
+/* outside the guard band, triangles must be clipped to be rasterized */
+#define NUSR_VERTEX_OUTCODE_GUARD_LEFT   0x40
+#define NUSR_VERTEX_OUTCODE_GUARD_RIGHT  0x80
+#define NUSR_VERTEX_OUTCODE_GUARD_BOTTOM 0x100
+#define NUSR_VERTEX_OUTCODE_GUARD_TOP    0x200
+#define NUSR_VERTEX_OUTCODE_CLIP ( \
+    NUSR_VERTEX_OUTCODE_NEAR | NUSR_VERTEX_OUTCODE_FAR | \
+    NUSR_VERTEX_OUTCODE_GUARD_LEFT | NUSR_VERTEX_OUTCODE_GUARD_RIGHT | \
+    NUSR_VERTEX_OUTCODE_GUARD_BOTTOM | NUSR_VERTEX_OUTCODE_GUARD_TOP \
+)
+
+typedef struct {
+    /* clip space positions (SoA) */
+    float *x;
+    float *y;
+    float *z;
+    float *w;
+    uint16_t *outcodes;
+    /* guard band extent in clip space (|x| <= guard_x * w) */
+    float guard_x;
+    float guard_y;
+    uint32_t count;
+    uint32_t capacity;
+} nusr_vertex_buffer_t;
+
+nu_result_t nusr_vertex_buffer_create(nusr_vertex_buffer_t *self);
+nu_result_t nusr_vertex_buffer_destroy(nusr_vertex_buffer_t *self);
+nu_result_t nusr_vertex_buffer_set_guard_band(nusr_vertex_buffer_t *self, float guard_x, float guard_y);
+nu_result_t nusr_vertex_buffer_transform(nusr_vertex_buffer_t *self, const nusr_mesh_t *mesh, const nu_mat4_t mvp);
+void nusr_vertex_buffer_get(const nusr_vertex_buffer_t *self, uint32_t i, nu_vec4_t v);
+
+#endif
\ No newline at end of file
@@ -16,6 +16,8 @@
 
 typedef struct {
     nuglfw_window_interface_t glfw_interface;
+    /* the last completed frame is not on the surface yet */
+    bool present_pending;
 } nusr_data_t;
 
 static nusr_data_t _data;
@@ -63,7 +65,8 @@ nu_result_t nusr_initialize(void)
 
     /* initialize viewport */
     nu_info(NUSR_LOGGER_NAME"Initializing viewport...\n");
-    nusr_viewport_initialize();
+    if (nusr_viewport_initialize() != NU_SUCCESS) return NU_FAILURE;
+    _data.present_pending = false;
 
     /* initialize scene */
     nu_info(NUSR_LOGGER_NAME"Intializing scene...\n");
@@ -99,20 +102,51 @@ nu_result_t nusr_terminate(void)
 
     return NU_SUCCESS;
 }
+static void present(nusr_renderbuffer_t *renderbuffer)
+{
+    _data.glfw_interface.present_surface(
+        renderbuffer->color_buffer.width, 
+        renderbuffer->color_buffer.height,
+        renderbuffer->color_buffer.pixels
+    );
+    _data.present_pending = false;
+}
 nu_result_t nusr_render(void)
 {
     test_update();
 
-    nusr_renderbuffer_t *renderbuffer;
+    nusr_renderbuffer_t *renderbuffer, *presented;
     nusr_viewport_get_renderbuffer(&renderbuffer);
+    nusr_viewport_get_presented_renderbuffer(&presented);
+
+    /* nothing changed, the surface keeps the last frame */
+    if (!nusr_viewport_is_dirty()) {
+        if (_data.present_pending) {
+            present(presented);
+        }
+        profile();
+        return NU_SUCCESS;
+    }
 
+    /* present the last frame while the workers rasterize this one, only
+     * dirty tiles are rasterized */
+    nusr_gui_invalidate_tiles(renderbuffer);
     nusr_scene_render(renderbuffer);
+    if (_data.present_pending) {
+        present(presented);
+    }
+    nusr_scene_wait();
+
+    /* finish the frame, it is presented on the next call */
+    nusr_renderbuffer_resolve(renderbuffer);
     nusr_gui_render(&renderbuffer->color_buffer);
-    _data.glfw_interface.present_surface(
-        renderbuffer->color_buffer.width, 
-        renderbuffer->color_buffer.height,
-        renderbuffer->color_buffer.pixels
-    );
+
+    /* pick the resolution of the next frame from the rasterization time */
+    float frame_time;
+    nusr_scene_get_frame_time(&frame_time);
+    nusr_viewport_update_resolution(frame_time);
+    nusr_viewport_swap();
+    _data.present_pending = true;
     
     profile();
 
@@ -253,18 +287,25 @@ static void test_initialize(void)
     nu_scale(staticmesh_info.transform, (nu_vec3_t){100.0, 0.1, 100.0});
     nu_renderer_staticmesh_create(&staticmesh_id, &staticmesh_info);
 
-    staticmesh_info.texture = brick_texture_id;
-
+    /* create brick instances */
+    static nu_mat4_t brick_transforms[5 * 5 * 5];
     for (uint32_t i = 0; i < 5; i++) {
         for (uint32_t j = 0; j < 5; j++) {
             for (uint32_t k = 0; k < 5; k++) {
-                nu_mat4_identity(staticmesh_info.transform);
-                nu_translate(staticmesh_info.transform, (nu_vec3_t){i * 2, k * 2, j * 2});
-                nu_scale(staticmesh_info.transform, (nu_vec3_t){0.5, 0.5, 0.5});
-                nu_renderer_staticmesh_create(&staticmesh_id, &staticmesh_info);
+                const uint32_t n = (i * 5 + j) * 5 + k;
+                nu_mat4_identity(brick_transforms[n]);
+                nu_translate(brick_transforms[n], (nu_vec3_t){i * 2, k * 2, j * 2});
+                nu_scale(brick_transforms[n], (nu_vec3_t){0.5, 0.5, 0.5});
             }
         }
     }
+    nu_renderer_instancedmesh_handle_t instancedmesh_id;
+    nu_renderer_instancedmesh_create_info_t instancedmesh_info = {};
+    instancedmesh_info.mesh = mesh_id;
+    instancedmesh_info.texture = brick_texture_id;
+    instancedmesh_info.instance_count = 5 * 5 * 5;
+    instancedmesh_info.transforms = (const nu_mat4_t*)brick_transforms;
+    nu_renderer_instancedmesh_create(&instancedmesh_id, &instancedmesh_info);
 }
 static void test_update(void)
 {
@@ -1,40 +1,200 @@
 #include "viewport.h"
 
 #include "../common/config.h"
+#include "../common/logger.h"
+
+#include <math.h>
+
+/* one renderbuffer is rasterized while the other is presented */
+#define RENDERBUFFER_COUNT 2
+
+/* internal resolution steps, in percent of the viewport size */
+static const uint32_t resolution_scales[] = {100, 85, 70, 60, 50};
+#define RESOLUTION_SCALE_COUNT (sizeof(resolution_scales) / sizeof(resolution_scales[0]))
+
+/* frame times are averaged over a window before raising the resolution,
+ * a single frame over the spike threshold lowers it at once */
+#define FRAME_TIME_WINDOW 16
+#define FRAME_TIME_SPIKE 1.5f
+#define FRAME_TIME_HEADROOM 0.9f
 
 typedef struct {
-    nusr_renderbuffer_t renderbuffer;
+    nusr_renderbuffer_t renderbuffers[RENDERBUFFER_COUNT];
+    uint32_t current;
+    uint32_t width;
+    uint32_t height;
+    nusr_depth_format_t depth_format;
+    uint32_t sample_count;
+    /* dynamic resolution */
+    bool dynamic_resolution;
+    float target_frame_time;
+    uint32_t scale;
+    float frame_time_sum;
+    uint32_t frame_count;
 } nusr_viewport_data_t;
 
 static nusr_viewport_data_t _data;
 
+static void scaled_size(uint32_t scale, uint32_t *width, uint32_t *height)
+{
+    *width = NU_MAX(1, _data.width * resolution_scales[scale] / 100);
+    *height = NU_MAX(1, _data.height * resolution_scales[scale] / 100);
+}
+static void set_scale(uint32_t scale)
+{
+    _data.scale = scale;
+    _data.frame_time_sum = 0.0f;
+    _data.frame_count = 0;
+}
+
 nu_result_t nusr_viewport_initialize(void)
 {
     /* creating renderbuffer */
     uint32_t default_width, default_height;
     nu_config_get_uint(NUSR_CONFIG_SOFTRAST_SECTION, NUSR_CONFIG_SOFTRAST_FRAMEBUFFER_WIDTH, &default_width, 640);
     nu_config_get_uint(NUSR_CONFIG_SOFTRAST_SECTION, NUSR_CONFIG_SOFTRAST_FRAMEBUFFER_HEIGHT, &default_height, 360);
-    nusr_renderbuffer_create(&_data.renderbuffer, default_width, default_height);
+    const char *depth_format_name;
+    nu_config_get_string(NUSR_CONFIG_SOFTRAST_SECTION, NUSR_CONFIG_SOFTRAST_DEPTH_FORMAT, &depth_format_name, "float32");
+    nusr_depth_format_t depth_format;
+    if (NU_MATCH(depth_format_name, "float32_reversed")) {
+        depth_format = NUSR_DEPTH_FORMAT_FLOAT32_REVERSED;
+    } else if (NU_MATCH(depth_format_name, "unorm24")) {
+        depth_format = NUSR_DEPTH_FORMAT_UNORM24;
+    } else if (NU_MATCH(depth_format_name, "unorm16")) {
+        depth_format = NUSR_DEPTH_FORMAT_UNORM16;
+    } else {
+        depth_format = NUSR_DEPTH_FORMAT_FLOAT32;
+    }
+    bool msaa;
+    nu_config_get_bool(NUSR_CONFIG_SOFTRAST_SECTION, NUSR_CONFIG_SOFTRAST_MSAA, &msaa, false);
+    uint32_t sample_count = msaa ? NUSR_RENDERBUFFER_MSAA_SAMPLE_COUNT : 1;
+    for (uint32_t i = 0; i < RENDERBUFFER_COUNT; i++) {
+        if (nusr_renderbuffer_create(&_data.renderbuffers[i], default_width, default_height, depth_format, sample_count) != NU_SUCCESS) {
+            nu_warning(NUSR_LOGGER_NAME"Unsupported framebuffer size %ux%u.\n", default_width, default_height);
+            return NU_FAILURE;
+        }
+    }
+    _data.current = 0;
+    _data.width = default_width;
+    _data.height = default_height;
+    _data.depth_format = depth_format;
+    _data.sample_count = sample_count;
+
+    /* dynamic resolution, the target frame time is in milliseconds */
+    uint32_t target_frame_time;
+    nu_config_get_bool(NUSR_CONFIG_SOFTRAST_SECTION, NUSR_CONFIG_SOFTRAST_DYNAMIC_RESOLUTION, &_data.dynamic_resolution, false);
+    nu_config_get_uint(NUSR_CONFIG_SOFTRAST_SECTION, NUSR_CONFIG_SOFTRAST_TARGET_FRAME_TIME, &target_frame_time, 16);
+    _data.target_frame_time = (float)target_frame_time;
+    set_scale(0);
 
     return NU_SUCCESS;
 }
 nu_result_t nusr_viewport_terminate(void)
 {
-    /* free renderbuffer */
-    nusr_renderbuffer_destroy(&_data.renderbuffer);
+    /* free renderbuffers */
+    for (uint32_t i = 0; i < RENDERBUFFER_COUNT; i++) {
+        nusr_renderbuffer_destroy(&_data.renderbuffers[i]);
+    }
     
     return NU_SUCCESS;
 }
 nu_result_t nusr_viewport_get_renderbuffer(nusr_renderbuffer_t **renderbuffer)
 {
-    *renderbuffer = &_data.renderbuffer;
+    *renderbuffer = &_data.renderbuffers[_data.current];
     
     return NU_SUCCESS;
 }
+nu_result_t nusr_viewport_get_presented_renderbuffer(nusr_renderbuffer_t **renderbuffer)
+{
+    /* last completed frame */
+    *renderbuffer = &_data.renderbuffers[(_data.current + RENDERBUFFER_COUNT - 1) % RENDERBUFFER_COUNT];
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_viewport_swap(void)
+{
+    _data.current = (_data.current + 1) % RENDERBUFFER_COUNT;
+
+    /* the next renderbuffer is no longer presented, it can be resized */
+    uint32_t width, height;
+    scaled_size(_data.scale, &width, &height);
+    nusr_renderbuffer_t *renderbuffer = &_data.renderbuffers[_data.current];
+    if (renderbuffer->color_buffer.width != width || renderbuffer->color_buffer.height != height) {
+        nusr_renderbuffer_destroy(renderbuffer);
+        nusr_renderbuffer_create(renderbuffer, width, height, _data.depth_format, _data.sample_count);
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_viewport_update_resolution(float frame_time)
+{
+    if (!_data.dynamic_resolution) return NU_SUCCESS;
+
+    /* drop a step on spikes and when the average is over the target */
+    _data.frame_time_sum += frame_time;
+    _data.frame_count++;
+    const float average = _data.frame_time_sum / _data.frame_count;
+    const bool spike = frame_time > _data.target_frame_time * FRAME_TIME_SPIKE;
+    if (spike || (_data.frame_count >= FRAME_TIME_WINDOW && average > _data.target_frame_time)) {
+        set_scale(NU_MIN(_data.scale + 1, RESOLUTION_SCALE_COUNT - 1));
+        return NU_SUCCESS;
+    }
+    if (_data.frame_count < FRAME_TIME_WINDOW) return NU_SUCCESS;
+
+    /* raise a step when the predicted time, proportional to the pixel
+     * count, stays under the target */
+    if (_data.scale > 0) {
+        const float ratio = (float)resolution_scales[_data.scale - 1] / resolution_scales[_data.scale];
+        if (average * ratio * ratio < _data.target_frame_time * FRAME_TIME_HEADROOM) {
+            set_scale(_data.scale - 1);
+            return NU_SUCCESS;
+        }
+    }
+    set_scale(_data.scale);
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_viewport_get_renderbuffers(nusr_renderbuffer_t **renderbuffers, uint32_t *count)
+{
+    *renderbuffers = _data.renderbuffers;
+    *count = RENDERBUFFER_COUNT;
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_viewport_invalidate(void)
+{
+    for (uint32_t i = 0; i < RENDERBUFFER_COUNT; i++) {
+        nusr_renderbuffer_t *renderbuffer = &_data.renderbuffers[i];
+        nusr_renderbuffer_invalidate_area(renderbuffer, 0, 0, renderbuffer->color_buffer.width, renderbuffer->color_buffer.height);
+    }
+
+    return NU_SUCCESS;
+}
+nu_result_t nusr_viewport_invalidate_area(int32_t xmin, int32_t ymin, int32_t xmax, int32_t ymax)
+{
+    /* the area is given in viewport pixels, every renderbuffer must redraw
+     * it since each one only redraws its own dirty tiles */
+    for (uint32_t i = 0; i < RENDERBUFFER_COUNT; i++) {
+        nusr_renderbuffer_t *renderbuffer = &_data.renderbuffers[i];
+        const float sx = (float)renderbuffer->color_buffer.width / (float)_data.width;
+        const float sy = (float)renderbuffer->color_buffer.height / (float)_data.height;
+        nusr_renderbuffer_invalidate_area(renderbuffer,
+            (int32_t)floorf(xmin * sx), (int32_t)floorf(ymin * sy),
+            (int32_t)ceilf(xmax * sx), (int32_t)ceilf(ymax * sy)
+        );
+    }
+
+    return NU_SUCCESS;
+}
+bool nusr_viewport_is_dirty(void)
+{
+    return nusr_renderbuffer_get_dirty_tile_count(&_data.renderbuffers[_data.current]) > 0;
+}
 nu_result_t nusr_viewport_get_size(uint32_t *width, uint32_t *height)
 {
-    *width = _data.renderbuffer.color_buffer.width;
-    *height = _data.renderbuffer.color_buffer.height;
+    /* renderbuffers may use a lower internal resolution */
+    *width = _data.width;
+    *height = _data.height;
 
     return NU_SUCCESS;
 }
\ No newline at end of file
@@ -6,6 +6,13 @@
 nu_result_t nusr_viewport_initialize(void);
 nu_result_t nusr_viewport_terminate(void);
 nu_result_t nusr_viewport_get_renderbuffer(nusr_renderbuffer_t **renderbuffer);
+nu_result_t nusr_viewport_get_presented_renderbuffer(nusr_renderbuffer_t **renderbuffer);
+nu_result_t nusr_viewport_swap(void);
+nu_result_t nusr_viewport_update_resolution(float frame_time);
+nu_result_t nusr_viewport_get_renderbuffers(nusr_renderbuffer_t **renderbuffers, uint32_t *count);
+nu_result_t nusr_viewport_invalidate(void);
+nu_result_t nusr_viewport_invalidate_area(int32_t xmin, int32_t ymin, int32_t xmax, int32_t ymax);
+bool nusr_viewport_is_dirty(void);
 nu_result_t nusr_viewport_get_size(uint32_t *width, uint32_t *height);
 
 #endif
\ No newline at end of file
@@ -52,41 +52,41 @@ void thread_pool_t::perform(nu_task_handle_t task, const nu_task_job_t *jobs, ui
 {
     for (uint32_t i = 0; i < count; i++)
     {
-        m_queues.at(m_next_worker)->push(jobs[i]);
         m_job_count.fetch_add(1, std::memory_order_relaxed);
+        m_queues.at(m_next_worker)->push(jobs[i]);
         m_next_worker = (m_next_worker + 1) % m_queues.size();
     }
 }
 void thread_pool_t::wait_task(nu_task_handle_t task)
 {
     std::unique_lock<std::mutex> lock(m_mutex);
-    while (m_job_count.load(std::memory_order_relaxed) > 0)
+    while (m_job_count.load(std::memory_order_acquire) > 0)
         m_cv_ended.wait(lock);
 }
 
 void thread_pool_t::worker_main(uint32_t id) noexcept
 {
-    bool was_working = false;
-
     nu_task_job_t job;
     while (m_running.load(std::memory_order_relaxed))
     {
         bool find = false;
         find = m_queues.at(id)->try_pop(job);
-        for (uint32_t i = 0; !find && i < m_queues.size() && i != id; i++)
-            find = m_queues.at(id)->try_pop(job); 
+        for (uint32_t i = 0; !find && i < m_queues.size(); i++)
+            if (i != id) find = m_queues.at(i)->try_pop(job);
 
         if (find)
         {
             job.func(job.args, 0, 0);
-            m_job_count.fetch_sub(1, std::memory_order_relaxed);
+            /* notify under lock so a waiting thread cannot miss the last job */
+            if (m_job_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_cv_ended.notify_all();
+            }
         }
         else
         {
-            if (was_working) m_cv_ended.notify_one();
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
-
-        was_working = find;
     }
 }
\ No newline at end of file